@@ -0,0 +1,299 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/uart.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "bench.h"
+#include "rest_server.h"
+
+static const char *TAG = "bench";
+
+static const char *const s_mode_names[] = {
+	"off", "generator", "loopback",
+};
+static const char *const s_pattern_names[] = {
+	"ascii", "ansi", "binary",
+};
+
+/* words for the text patterns */
+static const char *const s_words[] = {
+	"the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+	"kernel", "eth0:", "link", "up", "[", "OK", "]", "Started",
+	"systemd", "0x3f8", "irq", "17", "mounted", "/dev/mmcblk0p2", "...", "#",
+};
+/* escape sequences for the ANSI pattern */
+static const char *const s_escapes[] = {
+	"\x1b[0m", "\x1b[1m", "\x1b[31m", "\x1b[32m", "\x1b[1;33m", "\x1b[34;47m",
+	"\x1b[38;5;208m", "\x1b[K", "\x1b[2C", "\x1b[1D", "\x1b]0;bench\x07",
+};
+
+static bench_sink_t s_sink;
+/* shared with the httpd task, under s_lock */
+static bench_config_t s_config;
+static bool s_restart;					// new config to pick up
+static uint32_t s_records;
+static uint64_t s_bytes;
+static int64_t s_start_us;
+static int64_t s_stop_us;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t s_buf[UART_BUF_SIZE];	// records handed over at a time
+static TaskHandle_t s_task;
+static StaticTask_t s_task_tcb;
+static StackType_t s_task_stack[BENCH_TASK_STACK];
+
+
+/*
+ * CRC-32 (IEEE 802.3), nibble table
+ */
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len) {
+	static const uint32_t table[16] = {
+		0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+		0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+		0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+		0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+	};
+	crc = ~crc;
+	while(len--) {
+		crc ^= *data++;
+		crc = (crc >> 4) ^ table[crc & 0x0f];
+		crc = (crc >> 4) ^ table[crc & 0x0f];
+	}
+	return ~crc;
+}
+
+static uint32_t xorshift32(uint32_t *state) {
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+static void put_hex(uint8_t *dst, uint32_t val, int digits) {
+	static const char hex[] = "0123456789abcdef";
+	while(digits--) {
+		dst[digits] = hex[val & 0x0f];
+		val >>= 4;
+	}
+}
+
+/*
+ * append whole tokens while they fit, then pad with spaces: escape sequences
+ * are never cut
+ */
+static void fill_text(uint8_t *dst, int len, uint32_t *prng, bool ansi) {
+	int pos = 0;
+	while(1) {
+		uint32_t r = xorshift32(prng);
+		const char *tok = (ansi && (r & 0x100)) ?
+			s_escapes[r % (sizeof(s_escapes) / sizeof(s_escapes[0]))] :
+			s_words[r % (sizeof(s_words) / sizeof(s_words[0]))];
+		int tok_len = strlen(tok);
+		if(pos + tok_len + 1 > len) {
+			break;
+		}
+		memcpy(dst + pos, tok, tok_len);
+		pos += tok_len;
+		dst[pos++] = ' ';
+	}
+	memset(dst + pos, ' ', len - pos);
+}
+
+/*
+ * build record seq into dst (BENCH_RECORD_MAX bytes), return its size
+ */
+static int make_record(uint8_t *dst, uint32_t seq, bench_pattern_t pattern) {
+	uint32_t prng = seq * 2654435761u + 1;
+	int len = BENCH_PAYLOAD_MIN + xorshift32(&prng) %
+		(BENCH_PAYLOAD_MAX - BENCH_PAYLOAD_MIN + 1);
+	uint8_t *payload = dst + BENCH_HDR_SIZE;
+
+	dst[0] = '@';
+	put_hex(dst + 1, seq, 8);
+	put_hex(dst + 9, len, 4);
+	dst[13] = ':';
+	if(pattern == BENCH_PATTERN_BINARY) {
+		for(int i = 0; i < len; i++) {
+			payload[i] = xorshift32(&prng) >> 24;
+		}
+	} else {
+		fill_text(payload, len, &prng, pattern == BENCH_PATTERN_ANSI);
+	}
+	put_hex(payload + len, crc32_update(0, dst + 1, BENCH_HDR_SIZE - 1 + len),
+			8);
+	payload[len + 8] = '\r';
+	payload[len + 9] = '\n';
+	return BENCH_HDR_SIZE + len + BENCH_TRL_SIZE;
+}
+
+/*
+ * hand over a block and publish the counters: records made so far
+ */
+static void emit(bench_mode_t mode, const uint8_t *data, int len,
+		uint32_t records) {
+	if(mode == BENCH_LOOPBACK) {
+		// blocks while the TX ring is full: runs at the line rate at most
+		uart_write_bytes(UART_PORT_NUM, (const char *)data, len);
+	} else {
+		s_sink(data, len);
+	}
+	portENTER_CRITICAL(&s_lock);
+	s_records = records;
+	s_bytes += len;
+	portEXIT_CRITICAL(&s_lock);
+}
+
+/*
+ * generator task: sleeps while the benchmark is off, otherwise emits records
+ * every BENCH_PERIOD_MS as the rate allows (or back to back if it is 0)
+ */
+static void bench_task(void *pvParameters) {
+	TickType_t wake = xTaskGetTickCount();
+	uint64_t credit = 0;		// bytes allowed to be sent, times 1000
+	uint8_t record[BENCH_RECORD_MAX];
+	int record_len = 0;			// pending record, not yet paid for
+	bench_config_t config = { .mode = BENCH_OFF };
+	uint32_t records = 0;		// made in this run
+
+	while(1) {
+		bool restart = false;
+		portENTER_CRITICAL(&s_lock);
+		if(s_restart) {
+			// the counters of the last run are kept until the next one
+			s_restart = false;
+			config = s_config;
+			if(config.mode != BENCH_OFF) {
+				s_records = 0;
+				s_bytes = 0;
+				s_start_us = esp_timer_get_time();
+				restart = true;
+			}
+		}
+		portEXIT_CRITICAL(&s_lock);
+		if(restart) {
+			records = 0;
+			credit = 0;
+			record_len = 0;
+			wake = xTaskGetTickCount();
+		}
+		if(config.mode == BENCH_OFF) {
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			continue;
+		}
+
+		uint32_t rate = config.rate;
+		if(rate) {
+			vTaskDelayUntil(&wake, pdMS_TO_TICKS(BENCH_PERIOD_MS));
+			credit += (uint64_t)rate * BENCH_PERIOD_MS;
+			// do not burst after a stall
+			if(credit > (uint64_t)rate * 1000 / 10 + BENCH_RECORD_MAX * 1000) {
+				credit = (uint64_t)rate * 1000 / 10 + BENCH_RECORD_MAX * 1000;
+			}
+		}
+
+		int len = 0;
+		while(1) {
+			if(record_len == 0) {
+				record_len = make_record(record, records, config.pattern);
+			}
+			if(rate && credit < (uint64_t)record_len * 1000) {
+				break;
+			}
+			if(len + record_len > sizeof(s_buf)) {
+				emit(config.mode, s_buf, len, records);
+				len = 0;
+				if(rate == 0) {
+					break;
+				}
+			}
+			memcpy(s_buf + len, record, record_len);
+			len += record_len;
+			if(rate) {
+				credit -= (uint64_t)record_len * 1000;
+			}
+			records++;
+			record_len = 0;
+		}
+		if(len) {
+			emit(config.mode, s_buf, len, records);
+		}
+		if(rate == 0) {
+			// let the lower priority tasks run too
+			vTaskDelay(1);
+		}
+	}
+}
+
+/*
+ * start (counters are reset) or stop the benchmark
+ */
+esp_err_t bench_start(const bench_config_t *config) {
+	if(config->mode > BENCH_LOOPBACK || config->pattern > BENCH_PATTERN_BINARY
+			|| config->rate > BENCH_RATE_MAX) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	int64_t now = esp_timer_get_time();
+	portENTER_CRITICAL(&s_lock);
+	if(config->mode == BENCH_OFF && s_config.mode != BENCH_OFF) {
+		s_stop_us = now;
+	}
+	s_config = *config;
+	s_restart = true;
+	portEXIT_CRITICAL(&s_lock);
+	xTaskNotifyGive(s_task);
+	ESP_LOGI(TAG, "mode %s, pattern %s, rate %lu", bench_mode_name(config->mode),
+			bench_pattern_name(config->pattern), (unsigned long)config->rate);
+	return ESP_OK;
+}
+
+void bench_get_status(bench_status_t *status) {
+	int64_t now = esp_timer_get_time();
+	portENTER_CRITICAL(&s_lock);
+	status->config = s_config;
+	status->records = s_records;
+	status->bytes = s_bytes;
+	status->elapsed_ms = ((s_config.mode == BENCH_OFF ? s_stop_us : now) -
+			s_start_us) / 1000;
+	portEXIT_CRITICAL(&s_lock);
+}
+
+const char *bench_mode_name(bench_mode_t mode) {
+	return s_mode_names[mode];
+}
+
+const char *bench_pattern_name(bench_pattern_t pattern) {
+	return s_pattern_names[pattern];
+}
+
+int bench_mode_from_name(const char *name) {
+	for(int i = 0; i < sizeof(s_mode_names) / sizeof(s_mode_names[0]); i++) {
+		if(strcmp(name, s_mode_names[i]) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int bench_pattern_from_name(const char *name) {
+	for(int i = 0; i < sizeof(s_pattern_names) / sizeof(s_pattern_names[0]);
+			i++) {
+		if(strcmp(name, s_pattern_names[i]) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+ * set up the generator task, sink takes the records in generator mode
+ */
+esp_err_t bench_init(bench_sink_t sink) {
+	s_sink = sink;
+	s_config.mode = BENCH_OFF;
+	s_task = xTaskCreateStatic(bench_task, "bench", BENCH_TASK_STACK, NULL,
+			BENCH_TASK_PRIO, s_task_stack, &s_task_tcb);
+	return s_task ? ESP_OK : ESP_FAIL;
+}
@@ -0,0 +1,153 @@
+#include <string.h>
+
+#include "chunker.h"
+
+#define ESC					(0x1b)
+#define BEL					(0x07)
+
+static inline uint32_t read32(const uint8_t *p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/*
+ * length of the UTF-8 sequence started by lead byte c (1 if it is not one)
+ */
+static int utf8_len(uint8_t c) {
+	if(c >= 0xc0 && c < 0xe0) {
+		return 2;
+	} else if(c >= 0xe0 && c < 0xf0) {
+		return 3;
+	} else if(c >= 0xf0 && c < 0xf8) {
+		return 4;
+	}
+	return 1;
+}
+
+/*
+ * length of the escape sequence at p (p[0] is ESC), 0 if it does not end
+ * within n bytes; a byte that cannot continue it ends it as well
+ */
+static size_t esc_length(const uint8_t *p, size_t n) {
+	size_t i;
+
+	if(n < 2) {
+		return 0;
+	}
+	switch(p[1]) {
+	case '[':
+		// CSI: parameter and intermediate bytes, then the final byte
+		for(i = 2; i < n; i++) {
+			if(p[i] < 0x20 || p[i] > 0x3f) {
+				return p[i] <= 0x7e ? i + 1 : i;
+			}
+		}
+		return 0;
+	case ']':
+	case 'P':
+	case 'X':
+	case '^':
+	case '_':
+		// OSC, DCS, ...: terminated by BEL or ST (ESC \)
+		for(i = 2; i < n; i++) {
+			if(p[i] == BEL) {
+				return i + 1;
+			} else if(p[i] == ESC) {
+				return i + 1 < n ? i + 2 : 0;
+			}
+		}
+		return 0;
+	default:
+		// intermediate bytes, then the final byte
+		for(i = 1; i < n; i++) {
+			if(p[i] < 0x20 || p[i] > 0x2f) {
+				return p[i] <= 0x7e ? i + 1 : i;
+			}
+		}
+		return 0;
+	}
+}
+
+/*
+ * length of the part of data that can be sent on its own: an incomplete
+ * UTF-8 code point or escape sequence at the end (within CHUNK_HOLD_MAX
+ * bytes) is left for the next frame
+ */
+size_t chunk_boundary(const uint8_t *data, size_t len) {
+	size_t cut = len;
+	size_t i = len > CHUNK_HOLD_MAX ? len - CHUNK_HOLD_MAX : 0;
+
+	// the last lead byte within a code point length of the end
+	for(size_t j = len; j > 0 && len - j < 4; j--) {
+		uint8_t c = data[j - 1];
+		if((c & 0xc0) != 0x80) {
+			if(len - (j - 1) < utf8_len(c)) {
+				cut = j - 1;
+			}
+			break;
+		}
+	}
+
+	// the first sequence in the window that does not end in it
+	while(i < cut) {
+		const uint8_t *esc = memchr(data + i, ESC, cut - i);
+		if(esc == NULL) {
+			break;
+		}
+		size_t n = esc_length(esc, len - (esc - data));
+		if(n == 0) {
+			cut = esc - data;
+			break;
+		}
+		i = esc - data + n;
+	}
+	return cut;
+}
+
+/*
+ * strict UTF-8 check (no overlongs, surrogates or code points past U+10FFFF)
+ * as browsers close the websocket on an invalid text frame
+ */
+bool chunk_is_utf8(const uint8_t *data, size_t len) {
+	size_t i = 0;
+
+	while(i < len) {
+		// ASCII a word at a time
+		while(i + 4 <= len && (read32(data + i) & 0x80808080) == 0) {
+			i += 4;
+		}
+		if(i == len) {
+			break;
+		}
+		uint8_t c = data[i];
+		if(c < 0x80) {
+			i++;
+			continue;
+		}
+
+		uint8_t lo = 0x80, hi = 0xbf;	// range of the second byte
+		int n = utf8_len(c);
+		if(c < 0xc2 || c > 0xf4) {
+			return false;
+		} else if(c == 0xe0) {
+			lo = 0xa0;
+		} else if(c == 0xed) {
+			hi = 0x9f;
+		} else if(c == 0xf0) {
+			lo = 0x90;
+		} else if(c == 0xf4) {
+			hi = 0x8f;
+		}
+		if(len - i < n || data[i + 1] < lo || data[i + 1] > hi) {
+			return false;
+		}
+		for(int k = 2; k < n; k++) {
+			if((data[i + k] & 0xc0) != 0x80) {
+				return false;
+			}
+		}
+		i += n;
+	}
+	return true;
+}
@@ -0,0 +1,113 @@
+#include <string.h>
+
+#include "compress.h"
+
+#define MIN_MATCH			(4)
+#define LAST_LITERALS		(5)		// the block must end with literals
+#define MF_LIMIT			(12)	// no match may start this close to the end
+
+static uint16_t s_table[1 << LZ4_HASH_LOG];	// last position of each hash
+
+static inline uint32_t read32(const uint8_t *p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t hash32(uint32_t v) {
+	return (v * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+/*
+ * write a length continuation (the part that did not fit in the token)
+ */
+static uint8_t *put_length(uint8_t *op, size_t len) {
+	while (len >= 255) {
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (uint8_t)len;
+	return op;
+}
+
+/*
+ * compress one block in the LZ4 block format
+ *
+ * The input is compressed on its own (no dictionary) with a greedy parser,
+ * which is enough for console output and keeps the cost low. Blocks are
+ * limited to the format window. Returns the compressed size or 0 if it does
+ * not fit in dst. Not reentrant: the match table is shared.
+ */
+size_t compress_lz4(const uint8_t *src, size_t len, uint8_t *dst, size_t cap) {
+	const uint8_t *ip = src;
+	const uint8_t *anchor = src;
+	const uint8_t *const end = src + len;
+	uint8_t *op = dst;
+	uint8_t *const op_end = dst + cap;
+
+	if (len > LZ4_WINDOW_MAX) {
+		return 0;
+	}
+
+	memset(s_table, 0, sizeof(s_table));
+	if (len >= MF_LIMIT + 1) {
+		const uint8_t *const limit = end - MF_LIMIT;
+		const uint8_t *const match_limit = end - LAST_LITERALS;
+
+		while (ip < limit) {
+			uint32_t seq = read32(ip);
+			uint32_t h = hash32(seq);
+			const uint8_t *ref = src + s_table[h];
+			s_table[h] = (uint16_t)(ip - src);
+
+			if (ref >= ip || read32(ref) != seq) {
+				ip++;
+				continue;
+			}
+
+			// extend the match forward
+			size_t mlen = MIN_MATCH;
+			while (ip + mlen < match_limit && ref[mlen] == ip[mlen]) {
+				mlen++;
+			}
+
+			// token, literals, offset, match length
+			size_t lit = ip - anchor;
+			if (op + 1 + lit / 255 + 1 + lit + 2 + mlen / 255 + 1 > op_end) {
+				return 0;
+			}
+			uint8_t *token = op++;
+			*token = (uint8_t)((lit >= 15 ? 15 : lit) << 4);
+			if (lit >= 15) {
+				op = put_length(op, lit - 15);
+			}
+			memcpy(op, anchor, lit);
+			op += lit;
+			uint16_t offset = (uint16_t)(ip - ref);
+			*op++ = offset & 0xff;
+			*op++ = offset >> 8;
+			size_t ml = mlen - MIN_MATCH;
+			*token |= (uint8_t)(ml >= 15 ? 15 : ml);
+			if (ml >= 15) {
+				op = put_length(op, ml - 15);
+			}
+
+			ip += mlen;
+			anchor = ip;
+		}
+	}
+
+	// the rest goes out as literals
+	size_t lit = end - anchor;
+	if (op + 1 + lit / 255 + 1 + lit > op_end) {
+		return 0;
+	}
+	*op++ = (uint8_t)((lit >= 15 ? 15 : lit) << 4);
+	if (lit >= 15) {
+		op = put_length(op, lit - 15);
+	}
+	memcpy(op, anchor, lit);
+	op += lit;
+
+	return op - dst;
+}
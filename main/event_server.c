@@ -0,0 +1,912 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_vfs_eventfd.h"
+#include "lwip/sockets.h"
+#include "mbedtls/base64.h"
+#include "mbedtls/sha1.h"
+#include "driver/uart.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "chunker.h"
+#include "compress.h"
+#include "rest_server.h"
+#include "event_server.h"
+#include "scrollback.h"
+#include "ws_control.h"
+
+static const char *TAG = "event_server";
+
+/* websocket (RFC 6455) */
+#define WS_GUID					"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_KEY_MAX				(32)	// base64 of a 16 byte nonce is 24
+#define WS_FIN					(0x80)
+#define WS_MASKED				(0x80)
+#define WS_OP_CONT				(0x0)
+#define WS_OP_TEXT				(0x1)
+#define WS_OP_BINARY			(0x2)
+#define WS_OP_CLOSE				(0x8)
+#define WS_OP_PING				(0x9)
+#define WS_OP_PONG				(0xa)
+#define WS_CTRL_PAYLOAD_MAX		(125)	// ping, pong and close frames
+
+typedef enum {
+	CONN_HEAD,				// reading the request head
+	CONN_PROXY,				// passed through to esp_http_server
+	CONN_WS,				// websocket console
+} conn_state_t;
+
+/* what the continuation frames of a fragmented message carry */
+typedef enum {
+	MSG_DROP,				// nothing to pass on: no message or not accepted
+	MSG_TYPE,				// binary modes: the frame type byte is still due
+	MSG_UART,				// data for the UART
+} msg_state_t;
+
+/* client connection */
+typedef struct {
+	int fd;					// -1 if the slot is free
+	int peer;				// proxy: connection to esp_http_server
+	conn_state_t state;
+	ws_mode_t mode;
+	bool closing;			// proxy: close once tx_buf is sent
+	bool notify;			// state notification due
+	bool pong;				// pong due, with the ping payload in pong_buf
+	uint8_t msg;			// message being received (msg_state_t)
+	uint8_t rx_op;			// frame longer than rx_buf, passed on in pieces:
+	bool rx_fin;			//  its opcode and FIN bit,
+	uint8_t rx_mask_pos;	//  the mask byte of the next payload byte,
+	uint8_t rx_mask[4];		//  its mask
+	uint32_t rx_left;		//  and the payload still to come
+	uint32_t offset;		// next capture offset to frame
+	uint32_t lost;			// capture bytes dropped while the client lagged
+	uint32_t credit;		// bytes the client still takes, or WS_CREDIT_OFF
+	int64_t held_since;		// a partial sequence waits at offset (0: none)
+	int64_t active;			// proxy: last data passed on
+	uint32_t sg_off;		// zero copy payload still to send after tx_buf:
+	uint32_t sg_end;		//  capture offsets [sg_off, sg_end)
+	size_t tx_len;			// bytes in tx_buf
+	size_t tx_pos;			// bytes of tx_buf already sent
+	size_t rx_len;			// bytes in rx_buf
+	uint8_t pong_len;
+	uint8_t pong_buf[WS_CTRL_PAYLOAD_MAX];
+	uint8_t rx_buf[EVENT_BUF_SIZE];	// request head, ws frames / to httpd
+	uint8_t tx_buf[EVENT_BUF_SIZE];	// replies, frames / from httpd
+} event_conn_t;
+
+_Static_assert(sizeof(event_conn_t) <= 2 * EVENT_BUF_SIZE + EVENT_CONN_HDR_SIZE,
+		"update EVENT_CONN_HDR_SIZE");
+
+static event_conn_t s_conn[EVENT_CONN_MAX];
+static int s_conn_num;
+static uint8_t s_raw[EVENT_BUF_SIZE];	// capture data to compress
+static int s_event_fd = -1;				// new capture data or state
+static bool s_notify;					// state notification requested
+static portMUX_TYPE s_notify_lock = portMUX_INITIALIZER_UNLOCKED;
+static StaticTask_t s_task_tcb;
+static StackType_t s_task_stack[EVENT_SERVER_STACK];
+
+static void event_server_task(void *pvParameters);
+
+
+static void conn_close(event_conn_t *c) {
+	ESP_LOGI(TAG, "fd %d: closed", c->fd);
+	close(c->fd);
+	if(c->state == CONN_PROXY) {
+		close(c->peer);
+	}
+	c->fd = -1;
+	s_conn_num--;
+}
+
+/*
+ * websocket header for a frame of len bytes, written to end right before
+ * start of tx_buf; tx_buf then holds [header, start + in_buf)
+ */
+static void frame_queue(event_conn_t *c, uint8_t opcode, size_t start,
+		size_t in_buf, size_t len) {
+	uint8_t *p = c->tx_buf + start;
+	if(len < 126) {
+		*--p = len;
+	} else {
+		*--p = len & 0xff;
+		*--p = len >> 8;
+		*--p = 126;
+	}
+	*--p = WS_FIN | opcode;
+	c->tx_pos = p - c->tx_buf;
+	c->tx_len = start + in_buf;
+	STATS_ADD(ws_frames, 1);
+	STATS_ADD(ws_bytes, len);
+}
+
+/*
+ * how many of the n capture bytes (the last k of them at tail) to frame now:
+ * a partial code point or escape sequence waits, for CHUNK_HOLD_MS at most
+ */
+static size_t frame_cut(event_conn_t *c, const uint8_t *tail, size_t k,
+		size_t n, int64_t now) {
+#if CHUNK_HOLD_MS
+	if(c->held_since && now - c->held_since >= CHUNK_HOLD_MS * 1000) {
+		STATS_ADD(ws_hold_expired, 1);
+		c->held_since = 0;
+		return n;
+	}
+	size_t cut = n - k + chunk_boundary(tail, k);
+	if(cut == n) {
+		c->held_since = 0;
+	} else if(c->held_since == 0 || cut) {
+		// a new partial sequence
+		c->held_since = now;
+		STATS_ADD(ws_held, 1);
+	}
+	return cut;
+#else
+	return n;
+#endif
+}
+
+/*
+ * raw mode: the frame header goes to tx_buf, the payload is written from
+ * the capture ring as it is
+ */
+static void ws_fill_zero_copy(event_conn_t *c, size_t limit, int64_t now) {
+	scrollback_seg_t seg[2];
+	uint8_t tail[CHUNK_HOLD_MAX];
+
+	size_t n = scrollback_peek(&c->offset, limit, seg, &c->lost);
+	if(n == 0) {
+		return;
+	}
+	size_t k = n < sizeof(tail) ? n : sizeof(tail);
+	size_t k1 = k < seg[1].len ? k : seg[1].len;	// from the second segment
+	memcpy(tail, seg[0].data + seg[0].len - (k - k1), k - k1);
+	memcpy(tail + k - k1, seg[1].data + seg[1].len - k1, k1);
+
+	n = frame_cut(c, tail, k, n, now);
+	if(n == 0) {
+		return;
+	}
+	c->tx_buf[EVENT_HDR_MAX] = WS_FRAME_DATA;
+	frame_queue(c, WS_OP_BINARY, EVENT_HDR_MAX, WS_FRAME_HDR_SIZE,
+			WS_FRAME_HDR_SIZE + n);
+	c->sg_off = c->offset;
+	c->sg_end = c->offset + n;
+	c->offset += n;
+	if(c->credit != WS_CREDIT_OFF) {
+		c->credit -= n;
+	}
+}
+
+/*
+ * text and lz4 modes: the frame is built in tx_buf
+ */
+static void ws_fill_copy(event_conn_t *c, size_t limit, int64_t now) {
+	uint8_t *payload = c->tx_buf + EVENT_HDR_MAX;
+	uint8_t *data = c->mode == WS_MODE_LZ4 ? s_raw : payload;
+	size_t cap = EVENT_BUF_SIZE - EVENT_HDR_MAX;
+
+	size_t n = scrollback_read(&c->offset, data, limit < cap ? limit : cap,
+			&c->lost);
+	if(n == 0) {
+		return;
+	}
+	size_t k = n < CHUNK_HOLD_MAX ? n : CHUNK_HOLD_MAX;
+	size_t cut = frame_cut(c, data + n - k, k, n, now);
+	// the rest is read again next time
+	c->offset -= n - cut;
+	if(cut == 0) {
+		return;
+	}
+	if(c->credit != WS_CREDIT_OFF) {
+		c->credit -= cut;
+	}
+
+	if(c->mode == WS_MODE_TEXT) {
+		if(chunk_is_utf8(payload, cut)) {
+			frame_queue(c, WS_OP_TEXT, EVENT_HDR_MAX, cut, cut);
+			return;
+		}
+		// browsers close the connection on a text frame that is not UTF-8
+		STATS_ADD(ws_binary, 1);
+	} else {
+		int64_t start = esp_timer_get_time();
+		size_t zlen = compress_lz4(s_raw, cut, payload, cap);
+		STATS_ADD(lz4_us, esp_timer_get_time() - start);
+		STATS_ADD(lz4_in, cut);
+		if(zlen && WS_LZ4_HDR_SIZE + zlen < WS_FRAME_HDR_SIZE + cut) {
+			payload[-3] = WS_FRAME_DATA_LZ4;
+			payload[-2] = cut & 0xff;
+			payload[-1] = cut >> 8;
+			STATS_ADD(lz4_out, WS_LZ4_HDR_SIZE + zlen);
+			frame_queue(c, WS_OP_BINARY, EVENT_HDR_MAX - WS_LZ4_HDR_SIZE,
+					WS_LZ4_HDR_SIZE + zlen, WS_LZ4_HDR_SIZE + zlen);
+			return;
+		}
+		// send it stored if it does not get any smaller
+		memcpy(payload, s_raw, cut);
+		STATS_ADD(lz4_out, WS_FRAME_HDR_SIZE + cut);
+	}
+	payload[-1] = WS_FRAME_DATA;
+	frame_queue(c, WS_OP_BINARY, EVENT_HDR_MAX - WS_FRAME_HDR_SIZE,
+			WS_FRAME_HDR_SIZE + cut, WS_FRAME_HDR_SIZE + cut);
+}
+
+/*
+ * queue the next frame: a pong and a state notification go ahead of the data
+ */
+static void ws_fill(event_conn_t *c) {
+	uint32_t lost = c->lost;
+
+	c->tx_pos = c->tx_len = 0;
+	if(c->pong) {
+		c->pong = false;
+		memcpy(c->tx_buf + EVENT_HDR_MAX, c->pong_buf, c->pong_len);
+		frame_queue(c, WS_OP_PONG, EVENT_HDR_MAX, c->pong_len, c->pong_len);
+		return;
+	}
+	if(c->notify && c->mode != WS_MODE_TEXT) {
+		c->notify = false;
+		size_t n = ws_control_state(c->tx_buf + EVENT_HDR_MAX, c->credit);
+		if(n) {
+			frame_queue(c, WS_OP_BINARY, EVENT_HDR_MAX, n, n);
+			return;
+		}
+	}
+
+	size_t limit = c->credit;
+	if(c->mode == WS_MODE_BINARY) {
+		ws_fill_zero_copy(c, limit < EVENT_FRAME_MAX ? limit : EVENT_FRAME_MAX,
+				esp_timer_get_time());
+	} else {
+		// the LE16 raw length of an lz4 frame
+		ws_fill_copy(c, limit < UINT16_MAX ? limit : UINT16_MAX,
+				esp_timer_get_time());
+	}
+	if(c->lost != lost) {
+		ESP_LOGW(TAG, "fd %d: too slow, %lu bytes lost", c->fd,
+				(unsigned long)(c->lost - lost));
+	}
+}
+
+/*
+ * send as much as the socket takes without blocking: tx_buf and the zero
+ * copy payload go out together in one writev
+ */
+static void ws_pump(event_conn_t *c) {
+	while(1) {
+		if(c->tx_pos == c->tx_len && c->sg_off == c->sg_end) {
+			ws_fill(c);
+			if(c->tx_pos == c->tx_len) {
+				return;
+			}
+		}
+
+		struct iovec iov[3];
+		int cnt = 0;
+		size_t in_buf = c->tx_len - c->tx_pos;
+		size_t total = in_buf + (c->sg_end - c->sg_off);
+		if(in_buf) {
+			iov[cnt].iov_base = c->tx_buf + c->tx_pos;
+			iov[cnt++].iov_len = in_buf;
+		}
+		if(c->sg_off != c->sg_end) {
+			scrollback_seg_t seg[2];
+			uint32_t off = c->sg_off;
+			scrollback_peek(&off, c->sg_end - c->sg_off, seg, NULL);
+			if(off != c->sg_off) {
+				// a frame cannot be completed with other data
+				ESP_LOGW(TAG, "fd %d: frame payload overwritten", c->fd);
+				conn_close(c);
+				return;
+			}
+			for(int i = 0; i < 2; i++) {
+				if(seg[i].len) {
+					iov[cnt].iov_base = (void *)seg[i].data;
+					iov[cnt++].iov_len = seg[i].len;
+				}
+			}
+		}
+
+		// no VFS writev: straight to lwIP
+		ssize_t n = lwip_writev(c->fd, iov, cnt);
+		if(n < 0) {
+			if(errno != EAGAIN && errno != EWOULDBLOCK) {
+				conn_close(c);
+			}
+			// otherwise wait until the socket is writable again
+			return;
+		}
+		if(c->sg_off != c->sg_end && !scrollback_valid(c->sg_off)) {
+			ESP_LOGW(TAG, "fd %d: frame payload overwritten", c->fd);
+			conn_close(c);
+			return;
+		}
+		size_t k = (size_t)n < in_buf ? (size_t)n : in_buf;
+		c->tx_pos += k;
+		c->sg_off += n - k;
+		if((size_t)n < total) {
+			// the socket is full
+			return;
+		}
+	}
+}
+
+/*
+ * a frame from the client: data goes to the UART, control messages are
+ * handled at once. In binary modes a message starts with the frame type byte,
+ * also when it is fragmented.
+ */
+static void ws_frame(event_conn_t *c, uint8_t opcode, bool fin, uint8_t *data,
+		size_t len) {
+	switch(opcode) {
+	case WS_OP_TEXT:
+		c->msg = MSG_UART;
+		break;
+	case WS_OP_BINARY:
+		c->msg = c->mode == WS_MODE_TEXT ? MSG_UART : MSG_TYPE;
+		break;
+	case WS_OP_CONT:
+		break;
+	case WS_OP_PING:
+		// answered ahead of the data still to be sent
+		if(len <= WS_CTRL_PAYLOAD_MAX) {
+			memcpy(c->pong_buf, data, len);
+			c->pong_len = len;
+			c->pong = true;
+		}
+		return;
+	case WS_OP_CLOSE:
+		if(c->tx_pos == c->tx_len && c->sg_off == c->sg_end) {
+			uint8_t reply[2] = { WS_FIN | WS_OP_CLOSE, 0 };
+			send(c->fd, reply, sizeof(reply), MSG_DONTWAIT);
+		}
+		conn_close(c);
+		return;
+	default:
+		return;
+	}
+
+	if(c->msg == MSG_TYPE && len) {
+		if(data[0] != WS_FRAME_DATA) {
+			// control messages are not put together from fragments
+			if(fin) {
+				// invalid ones are dropped, the connection stays
+				ws_control_handle(data, len, &c->credit);
+			} else {
+				ESP_LOGW(TAG, "fd %d: fragmented control message dropped",
+						c->fd);
+			}
+			c->msg = MSG_DROP;
+			return;
+		}
+		c->msg = MSG_UART;
+		data++;
+		len--;
+	}
+	if(c->msg == MSG_UART && len) {
+		uart_write_bytes(UART_PORT_NUM, (const char *)data, len);
+	}
+	if(fin) {
+		c->msg = MSG_DROP;
+	}
+}
+
+static void ws_recv(event_conn_t *c) {
+	int n = recv(c->fd, c->rx_buf + c->rx_len, sizeof(c->rx_buf) - c->rx_len,
+			MSG_DONTWAIT);
+	if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+		conn_close(c);
+		return;
+	}
+	if(n < 0) {
+		return;
+	}
+	c->rx_len += n;
+
+	// complete frames; client frames are always masked
+	size_t pos = 0;
+	while(pos < c->rx_len) {
+		uint8_t *p = c->rx_buf + pos;
+		size_t avail = c->rx_len - pos;
+		if(c->rx_left) {
+			// a frame that does not fit (a paste) goes on as it comes, like
+			// the fragments of a message
+			size_t len = avail < c->rx_left ? avail : c->rx_left;
+			for(size_t i = 0; i < len; i++) {
+				p[i] ^= c->rx_mask[(c->rx_mask_pos + i) & 3];
+			}
+			c->rx_mask_pos = (c->rx_mask_pos + len) & 3;
+			c->rx_left -= len;
+			uint8_t opcode = c->rx_op;
+			c->rx_op = WS_OP_CONT;
+			ws_frame(c, opcode, c->rx_left == 0 && c->rx_fin, p, len);
+			if(c->fd < 0) {
+				return;
+			}
+			pos += len;
+			continue;
+		}
+		if(avail < 2) {
+			break;
+		}
+		uint8_t opcode = p[0] & 0x0f;
+		bool valid = p[1] & WS_MASKED;
+		size_t len = p[1] & 0x7f;
+		size_t hdr = 2 + 4;
+		if(len == 126) {
+			if(avail < 4) {
+				break;
+			}
+			len = (p[2] << 8) | p[3];
+			hdr += 2;
+		} else if(len == 127) {
+			if(avail < 10) {
+				break;
+			}
+			// 4 GB at most
+			valid &= (p[2] | p[3] | p[4] | p[5]) == 0;
+			len = ((uint32_t)p[6] << 24) | (p[7] << 16) | (p[8] << 8) | p[9];
+			hdr += 8;
+		}
+		if(!valid || ((opcode & 0x8) && len > WS_CTRL_PAYLOAD_MAX)) {
+			ESP_LOGW(TAG, "fd %d: frame not accepted", c->fd);
+			conn_close(c);
+			return;
+		}
+		if(avail < hdr) {
+			break;
+		}
+		uint8_t *mask = p + hdr - 4;
+		if(hdr + len > sizeof(c->rx_buf)) {
+			memcpy(c->rx_mask, mask, sizeof(c->rx_mask));
+			c->rx_mask_pos = 0;
+			c->rx_op = opcode;
+			c->rx_fin = p[0] & WS_FIN;
+			c->rx_left = len;
+			pos += hdr;
+			continue;
+		}
+		if(avail < hdr + len) {
+			break;
+		}
+		uint8_t *data = p + hdr;
+		for(size_t i = 0; i < len; i++) {
+			data[i] ^= mask[i & 3];
+		}
+		ws_frame(c, opcode, p[0] & WS_FIN, data, len);
+		if(c->fd < 0) {
+			return;
+		}
+		pos += hdr + len;
+	}
+	memmove(c->rx_buf, c->rx_buf + pos, c->rx_len - pos);
+	c->rx_len -= pos;
+}
+
+/*
+ * value of a header of the request head (NUL terminated), len is set to its
+ * length
+ */
+static const char *find_header(const char *head, const char *name,
+		size_t *len) {
+	size_t name_len = strlen(name);
+	for(const char *line = strstr(head, "\r\n"); line;
+			line = strstr(line, "\r\n")) {
+		line += 2;
+		if(strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+			const char *val = line + name_len + 1;
+			while(*val == ' ') {
+				val++;
+			}
+			*len = strcspn(val, "\r\n");
+			return val;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * switch to the websocket protocol, head_len bytes of rx_buf were the head
+ */
+static void ws_accept(event_conn_t *c, size_t head_len) {
+	char *head = (char *)c->rx_buf;
+	char key[WS_KEY_MAX + sizeof(WS_GUID)];
+	uint8_t sha1[20];
+	char accept[32];
+	size_t len;
+
+	const char *val = find_header(head, "Sec-WebSocket-Key", &len);
+	if(val == NULL || len > WS_KEY_MAX) {
+		ESP_LOGW(TAG, "fd %d: bad websocket request", c->fd);
+		conn_close(c);
+		return;
+	}
+	memcpy(key, val, len);
+	memcpy(key + len, WS_GUID, sizeof(WS_GUID) - 1);
+	mbedtls_sha1((const unsigned char *)key, len + sizeof(WS_GUID) - 1, sha1);
+	mbedtls_base64_encode((unsigned char *)accept, sizeof(accept), &len, sha1,
+			sizeof(sha1));
+	accept[len] = 0x00;
+
+	// framing requested by the client: /ws?codec=raw|lz4
+	const char *codec = strstr(head, "codec=");
+	c->mode = WS_MODE_TEXT;
+	if(codec && codec < head + 4 + strcspn(head + 4, " ")) {
+		if(strncmp(codec + 6, "lz4", 3) == 0) {
+			c->mode = WS_MODE_LZ4;
+		} else if(strncmp(codec + 6, "raw", 3) == 0) {
+			c->mode = WS_MODE_BINARY;
+		}
+	}
+
+	c->tx_pos = 0;
+	c->tx_len = snprintf((char *)c->tx_buf, sizeof(c->tx_buf),
+			"HTTP/1.1 101 Switching Protocols\r\n"
+			"Upgrade: websocket\r\n"
+			"Connection: Upgrade\r\n"
+			"Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+	// frames sent right after the request
+	memmove(c->rx_buf, c->rx_buf + head_len, c->rx_len - head_len);
+	c->rx_len -= head_len;
+
+	c->state = CONN_WS;
+	c->offset = scrollback_head();
+	c->credit = WS_CREDIT_OFF;
+	c->held_since = 0;
+	c->sg_off = c->sg_end = 0;
+	// the state notification follows the handshake
+	c->notify = true;
+	ESP_LOGI(TAG, "fd %d: websocket mode %d", c->fd, c->mode);
+}
+
+/*
+ * anything but the console goes to esp_http_server on EVENT_HTTPD_PORT
+ */
+static void proxy_open(event_conn_t *c) {
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(EVENT_HTTPD_PORT),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+	if(fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		ESP_LOGE(TAG, "fd %d: httpd not reachable (%d)", c->fd, errno);
+		if(fd >= 0) {
+			close(fd);
+		}
+		conn_close(c);
+		return;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+	c->peer = fd;
+	c->state = CONN_PROXY;
+	c->tx_pos = c->tx_len = 0;
+}
+
+/*
+ * collect the request head, then pick the websocket or the proxy
+ */
+static void conn_head(event_conn_t *c) {
+	// one byte kept for the NUL
+	int n = recv(c->fd, c->rx_buf + c->rx_len, sizeof(c->rx_buf) - 1 - c->rx_len,
+			MSG_DONTWAIT);
+	if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+		conn_close(c);
+		return;
+	}
+	if(n < 0) {
+		return;
+	}
+	c->rx_len += n;
+	c->rx_buf[c->rx_len] = 0x00;
+
+	char *head = (char *)c->rx_buf;
+	char *end = strstr(head, "\r\n\r\n");
+	if(end == NULL) {
+		if(c->rx_len == sizeof(c->rx_buf) - 1) {
+			static const char reply[] =
+				"HTTP/1.1 431 Request Header Fields Too Large\r\n\r\n";
+			send(c->fd, reply, sizeof(reply) - 1, MSG_DONTWAIT);
+			conn_close(c);
+		}
+		return;
+	}
+
+	size_t len;
+	const char *upgrade = find_header(head, "Upgrade", &len);
+	if(strncmp(head, "GET /ws", 7) == 0 && (head[7] == ' ' || head[7] == '?') &&
+			upgrade && len == 9 && strncasecmp(upgrade, "websocket", 9) == 0) {
+		ws_accept(c, end + 4 - head);
+	} else {
+		proxy_open(c);
+	}
+}
+
+/*
+ * pass the bytes on in both directions
+ */
+static void proxy_io(event_conn_t *c, fd_set *rfds) {
+	int n;
+
+	if(FD_ISSET(c->fd, rfds) && c->rx_len < sizeof(c->rx_buf)) {
+		n = recv(c->fd, c->rx_buf + c->rx_len, sizeof(c->rx_buf) - c->rx_len,
+				MSG_DONTWAIT);
+		if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+			conn_close(c);
+			return;
+		}
+		c->rx_len += n > 0 ? n : 0;
+		c->active = esp_timer_get_time();
+	}
+	if(c->rx_len) {
+		n = send(c->peer, c->rx_buf, c->rx_len, MSG_DONTWAIT);
+		if(n > 0) {
+			memmove(c->rx_buf, c->rx_buf + n, c->rx_len - n);
+			c->rx_len -= n;
+		}
+	}
+
+	if(FD_ISSET(c->peer, rfds) && c->tx_len < sizeof(c->tx_buf)) {
+		n = recv(c->peer, c->tx_buf + c->tx_len, sizeof(c->tx_buf) - c->tx_len,
+				MSG_DONTWAIT);
+		if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+			// httpd is done: close after the rest is sent
+			c->closing = true;
+		}
+		c->tx_len += n > 0 ? n : 0;
+		c->active = esp_timer_get_time();
+	}
+	if(c->tx_pos < c->tx_len) {
+		n = send(c->fd, c->tx_buf + c->tx_pos, c->tx_len - c->tx_pos,
+				MSG_DONTWAIT);
+		if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+			conn_close(c);
+			return;
+		}
+		c->tx_pos += n > 0 ? n : 0;
+	}
+	if(c->tx_pos == c->tx_len) {
+		c->tx_pos = c->tx_len = 0;
+		if(c->closing) {
+			conn_close(c);
+		}
+	}
+}
+
+/*
+ * free slot for a new connection, else the least recently used idle proxy
+ * connection (browsers keep them open)
+ */
+static event_conn_t *conn_slot(bool purge) {
+	int64_t idle = esp_timer_get_time() - EVENT_IDLE_MS * 1000;
+	event_conn_t *lru = NULL;
+	for(int i = 0; i < EVENT_CONN_MAX; i++) {
+		event_conn_t *c = &s_conn[i];
+		if(c->fd < 0) {
+			return c;
+		}
+		if(c->state == CONN_PROXY && c->rx_len == 0 && c->tx_len == 0 &&
+				c->active <= idle && (lru == NULL || c->active < lru->active)) {
+			lru = c;
+		}
+	}
+	if(lru && purge) {
+		ESP_LOGI(TAG, "fd %d: purged", lru->fd);
+		conn_close(lru);
+	}
+	return lru;
+}
+
+static void conn_accept(int listen_fd) {
+	event_conn_t *c = conn_slot(true);
+	if(c == NULL) {
+		return;
+	}
+	int fd = accept(listen_fd, NULL, NULL);
+	if(fd < 0) {
+		return;
+	}
+
+	int opt = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+	memset(c, 0, offsetof(event_conn_t, rx_buf));
+	c->fd = fd;
+	c->peer = -1;
+	c->state = CONN_HEAD;
+	c->active = esp_timer_get_time();
+	s_conn_num++;
+}
+
+static int listen_on(uint16_t port) {
+	int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+	if(fd < 0) {
+		ESP_LOGE(TAG, "socket failed (%d)", errno);
+		return -1;
+	}
+	int opt = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_ANY),
+	};
+	if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+			listen(fd, EVENT_LISTEN_BACKLOG) != 0) {
+		ESP_LOGE(TAG, "failed to listen on port %d (%d)", port, errno);
+		close(fd);
+		return -1;
+	}
+	ESP_LOGI(TAG, "listening on port %d", port);
+	return fd;
+}
+
+/*
+ * single task serving all connections with select()
+ */
+static void event_server_task(void *pvParameters) {
+	int listen_fd = listen_on(EVENT_PORT);
+	fd_set rfds, wfds;
+
+	if(listen_fd < 0) {
+		vTaskDelete(NULL);
+	}
+
+	while(1) {
+		int max_fd = s_event_fd > listen_fd ? s_event_fd : listen_fd;
+		int64_t now = esp_timer_get_time();
+		int64_t wait = -1;		// until the first held back sequence expires
+		int64_t idle = -1;		// until the first proxy connection is idle
+
+		FD_ZERO(&rfds);
+		FD_ZERO(&wfds);
+		FD_SET(s_event_fd, &rfds);
+		for(int i = 0; i < EVENT_CONN_MAX; i++) {
+			event_conn_t *c = &s_conn[i];
+			if(c->fd < 0) {
+				continue;
+			}
+			max_fd = c->fd > max_fd ? c->fd : max_fd;
+			if(c->state == CONN_PROXY) {
+				if(c->rx_len < sizeof(c->rx_buf)) {
+					FD_SET(c->fd, &rfds);
+				}
+				if(c->tx_len < sizeof(c->tx_buf) && !c->closing) {
+					FD_SET(c->peer, &rfds);
+				}
+				if(c->rx_len) {
+					FD_SET(c->peer, &wfds);
+				}
+				max_fd = c->peer > max_fd ? c->peer : max_fd;
+				if(c->rx_len == 0 && c->tx_len == 0) {
+					int64_t left = c->active + EVENT_IDLE_MS * 1000 - now;
+					left = left > 0 ? left : 0;
+					idle = (idle < 0 || left < idle) ? left : idle;
+				}
+			} else {
+				FD_SET(c->fd, &rfds);
+			}
+			if(c->tx_pos < c->tx_len || c->sg_off != c->sg_end) {
+				FD_SET(c->fd, &wfds);
+			}
+			if(c->state == CONN_WS && c->held_since) {
+				int64_t left = c->held_since + CHUNK_HOLD_MS * 1000 - now;
+				left = left > 0 ? left : 0;
+				wait = (wait < 0 || left < wait) ? left : wait;
+			}
+		}
+		if(conn_slot(false)) {
+			FD_SET(listen_fd, &rfds);
+		} else if(idle >= 0) {
+			// the others wait in the listen backlog: look again then
+			wait = (wait < 0 || idle < wait) ? idle : wait;
+		}
+
+		struct timeval tv = {
+			.tv_sec = wait / 1000000,
+			.tv_usec = wait % 1000000,
+		};
+		if(select(max_fd + 1, &rfds, &wfds, NULL, wait < 0 ? NULL : &tv) < 0) {
+			ESP_LOGE(TAG, "select failed (%d)", errno);
+			vTaskDelay(100 / portTICK_PERIOD_MS);
+			continue;
+		}
+
+		if(FD_ISSET(s_event_fd, &rfds)) {
+			uint64_t count;
+			read(s_event_fd, &count, sizeof(count));
+		}
+		// a request made in between is not lost
+		portENTER_CRITICAL(&s_notify_lock);
+		bool notify = s_notify;
+		s_notify = false;
+		portEXIT_CRITICAL(&s_notify_lock);
+		if(FD_ISSET(listen_fd, &rfds)) {
+			conn_accept(listen_fd);
+		}
+		for(int i = 0; i < EVENT_CONN_MAX; i++) {
+			event_conn_t *c = &s_conn[i];
+			if(c->fd < 0) {
+				continue;
+			}
+			switch(c->state) {
+			case CONN_HEAD:
+				if(FD_ISSET(c->fd, &rfds)) {
+					conn_head(c);
+				}
+				break;
+			case CONN_PROXY:
+				proxy_io(c, &rfds);
+				break;
+			case CONN_WS:
+				c->notify |= notify;
+				if(FD_ISSET(c->fd, &rfds)) {
+					ws_recv(c);
+				}
+				// new capture data, credit or room in the socket
+				if(c->fd >= 0) {
+					ws_pump(c);
+				}
+				break;
+			}
+		}
+	}
+}
+
+
+/*
+ * wake up the server: new data in the capture store
+ */
+void event_server_notify(void) {
+	if(s_conn_num > 0) {
+		uint64_t count = 1;
+		write(s_event_fd, &count, sizeof(count));
+	}
+}
+
+/*
+ * send a state notification to the websocket clients
+ */
+void event_server_notify_state(void) {
+	portENTER_CRITICAL(&s_notify_lock);
+	s_notify = true;
+	portEXIT_CRITICAL(&s_notify_lock);
+	if(s_event_fd >= 0) {
+		uint64_t count = 1;
+		write(s_event_fd, &count, sizeof(count));
+	}
+}
+
+/*
+ * start the server on EVENT_PORT; esp_http_server has to listen on
+ * EVENT_HTTPD_PORT
+ */
+esp_err_t start_event_server(void) {
+	esp_vfs_eventfd_config_t config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+	esp_err_t ret = esp_vfs_eventfd_register(&config);
+	if(ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+		ESP_LOGE(TAG, "eventfd registration failed (%s)", esp_err_to_name(ret));
+		return ret;
+	}
+	s_event_fd = eventfd(0, 0);
+	if(s_event_fd < 0) {
+		ESP_LOGE(TAG, "eventfd failed (%d)", errno);
+		return ESP_FAIL;
+	}
+
+	for(int i = 0; i < EVENT_CONN_MAX; i++) {
+		s_conn[i].fd = -1;
+	}
+	xTaskCreateStatic(event_server_task, "event_server", EVENT_SERVER_STACK,
+			NULL, EVENT_SERVER_PRIO, s_task_stack, &s_task_tcb);
+	return ESP_OK;
+}
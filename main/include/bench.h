@@ -0,0 +1,70 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BENCH_TASK_STACK		(3072)
+#define BENCH_TASK_PRIO			(5)		// below uart_read_task
+#define BENCH_PERIOD_MS			(10)	// rate limiter tick
+#define BENCH_RATE_MAX			(1000000)	// bytes/sec, 0: as fast as possible
+#define BENCH_PAYLOAD_MIN		(16)
+#define BENCH_PAYLOAD_MAX		(200)
+
+/*
+ * benchmark record, all numbers in lower case hex:
+ *  '@' seq(8) len(4) ':' payload(len) crc(8) '\r' '\n'
+ * crc is the CRC-32 (IEEE) of everything between '@' and the crc itself.
+ * The receiver checks the crc and counts the gaps in seq as lost records.
+ */
+#define BENCH_HDR_SIZE			(14)
+#define BENCH_TRL_SIZE			(10)
+#define BENCH_RECORD_MAX		(BENCH_HDR_SIZE + BENCH_PAYLOAD_MAX + BENCH_TRL_SIZE)
+
+typedef enum {
+	BENCH_OFF = 0,
+	BENCH_GENERATOR,		// records are fed to the console input
+	BENCH_LOOPBACK,			// records are sent to UART TX, wired to RX
+} bench_mode_t;
+
+typedef enum {
+	BENCH_PATTERN_ASCII = 0,	// printable text
+	BENCH_PATTERN_ANSI,			// text with SGR and cursor sequences
+	BENCH_PATTERN_BINARY,		// random bytes
+} bench_pattern_t;
+
+typedef struct {
+	bench_mode_t mode;
+	bench_pattern_t pattern;
+	uint32_t rate;			// bytes/sec
+} bench_config_t;
+
+typedef struct {
+	bench_config_t config;
+	uint32_t records;		// records generated since start
+	uint64_t bytes;			// bytes generated since start
+	uint32_t elapsed_ms;	// time since start
+} bench_status_t;
+
+typedef void (*bench_sink_t)(const uint8_t *data, int len);
+
+esp_err_t bench_init(bench_sink_t sink);
+esp_err_t bench_start(const bench_config_t *config);
+void bench_get_status(bench_status_t *status);
+
+const char *bench_mode_name(bench_mode_t mode);
+const char *bench_pattern_name(bench_pattern_t pattern);
+int bench_mode_from_name(const char *name);
+int bench_pattern_from_name(const char *name);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BENCH_H_
@@ -0,0 +1,23 @@
+#ifndef CHUNKER_H_
+#define CHUNKER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHUNK_HOLD_MAX		(64)	// most bytes held back for the next frame
+#define CHUNK_HOLD_MS		(CONFIG_WEBTERM_WS_HOLD_MS)
+
+size_t chunk_boundary(const uint8_t *data, size_t len);
+bool chunk_is_utf8(const uint8_t *data, size_t len);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CHUNKER_H_
@@ -0,0 +1,23 @@
+#ifndef COMPRESS_H_
+#define COMPRESS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LZ4_HASH_LOG		(10)	// 2 KB match table
+#define LZ4_WINDOW_MAX		(65535)	// largest match offset of the format
+// worst case size of a compressed block
+#define LZ4_COMPRESS_BOUND(n)	((n) + (n) / 255 + 16)
+
+size_t compress_lz4(const uint8_t *src, size_t len, uint8_t *dst, size_t cap);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMPRESS_H_
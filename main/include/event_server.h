@@ -0,0 +1,31 @@
+#ifndef EVENT_SERVER_H_
+#define EVENT_SERVER_H_
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EVENT_CONN_MAX			(CONFIG_WEBTERM_EVENT_CONN_MAX)
+#define EVENT_BUF_SIZE			(CONFIG_WEBTERM_EVENT_BUF_SIZE)	// rx and tx each
+#define EVENT_HTTPD_PORT		(CONFIG_WEBTERM_EVENT_HTTPD_PORT)
+#define EVENT_SERVER_STACK		(CONFIG_WEBTERM_EVENT_SERVER_STACK)
+#define EVENT_SERVER_PRIO		(5)
+#define EVENT_PORT				(80)
+#define EVENT_LISTEN_BACKLOG	(8)		// page loads open several at once
+#define EVENT_IDLE_MS			(500)	// a proxy connection may be purged after
+#define EVENT_FRAME_MAX			(8192)	// capture bytes per zero copy frame
+#define EVENT_HDR_MAX			(4 + WS_LZ4_HDR_SIZE)	// ws + frame header
+#define EVENT_CONN_HDR_SIZE		(216)	// event_conn_t but buffers, for the budget
+
+esp_err_t start_event_server(void);
+void event_server_notify(void);
+void event_server_notify_state(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EVENT_SERVER_H_
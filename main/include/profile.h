@@ -0,0 +1,74 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROFILE_TASK_STACK		(3072)
+#define PROFILE_TASK_PRIO		(1)		// just above idle
+#define PROFILE_TASK_MAX		(32)	// tasks reported
+#define PROFILE_INTERVAL_MIN	(100)	// msec
+#define PROFILE_INTERVAL_MAX	(60000)
+#define PROFILE_NAME_LEN		(16)
+#define PROFILE_CORE_ANY		(-1)	// task not pinned to a core
+// structure sizes for ram_budget.cmake, checked in profile.c
+#define PROFILE_STATUS_SIZE		(72)	// TaskStatus_t and the last counters
+#define PROFILE_TASK_SIZE		(28)	// profile_task_t
+#define PROFILE_SAMPLE_HDR_SIZE	(96)	// profile_sample_t but task[]
+
+/* heap capabilities reported */
+typedef enum {
+	PROFILE_HEAP_INTERNAL = 0,
+	PROFILE_HEAP_DMA,
+	PROFILE_HEAP_8BIT,
+	PROFILE_HEAP_SPIRAM,
+	PROFILE_HEAP_NUM,
+} profile_heap_id_t;
+
+typedef struct {
+	char name[PROFILE_NAME_LEN];
+	int8_t core;			// pinned core or PROFILE_CORE_ANY
+	uint8_t priority;
+	uint8_t state;			// eTaskState
+	uint16_t cpu;			// load over the interval, 0.01 % of one core
+	uint32_t stack_free;	// stack high-water mark: bytes never used
+} profile_task_t;
+
+typedef struct {
+	uint32_t total;			// 0 if there is no such memory
+	uint32_t free;
+	uint32_t largest;		// largest free block
+	uint32_t min_free;		// lowest free since boot
+} profile_heap_t;
+
+typedef struct {
+	uint32_t seq;			// samples taken, 0: none yet
+	uint32_t time_ms;		// uptime when taken
+	uint32_t interval_ms;	// time covered by the loads
+	uint32_t sample_us;		// time the sample took
+	uint16_t core_load[portNUM_PROCESSORS];	// 0.01 %
+	int task_num;
+	profile_task_t task[PROFILE_TASK_MAX];
+	profile_heap_t heap[PROFILE_HEAP_NUM];
+} profile_sample_t;
+
+esp_err_t profile_init(uint32_t interval_ms);
+esp_err_t profile_set_interval(uint32_t interval_ms);
+uint32_t profile_get_interval(void);
+void profile_get(profile_sample_t *sample);
+
+const char *profile_heap_name(profile_heap_id_t id);
+const char *profile_state_name(uint8_t state);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILE_H_
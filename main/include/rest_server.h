@@ -1,16 +1,29 @@
 #ifndef REST_SERVER_H_
 #define REST_SERVER_H_
 
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define FILE_PATH_MAX		(ESP_VFS_PATH_MAX + 128)
-#define SCRATCH_BUFSIZE		(10240)
+#define SCRATCH_BUFSIZE		(CONFIG_WEBTERM_SCRATCH_BUF_SIZE)
 
-// TODO: bring this to kconfig
-#define UART_BUF_SIZE		(1024)
+#define UART_BUF_SIZE		(CONFIG_WEBTERM_UART_BUF_SIZE)
+#define STREAM_BUF_SIZE		(CONFIG_WEBTERM_STREAM_BUF_SIZE)	// UART to WS
+#define WS_RX_BUF_SIZE		(CONFIG_WEBTERM_WS_RX_BUF_SIZE)	// ws frame read piece
+#define UART_TASK_STACK		(CONFIG_WEBTERM_UART_TASK_STACK)
+#define PWR_TASK_STACK		(2048)
+#define HTTPD_STACK			(CONFIG_WEBTERM_HTTPD_STACK)
 #define UART_PORT_NUM		UART_NUM_1	// UART_NUM_0 is used by the DevKit USB
+#define UART_QUEUE_SIZE		(20)		// UART driver event queue
+#define SERIAL_BAUD_MIN		(300)
+#define SERIAL_BAUD_MAX		(5000000)
+
+#define SEARCH_HITS_MAX		(50)		// matches per search request
+#define SEARCH_CONTEXT_MAX	(5)			// context lines around a match
 
 #define GPIO_PWR_WAKE		(16)	// Set ground to shutdown
 									//  PIN 5: dtoverlay=gpio-shutdown
@@ -19,7 +32,79 @@ extern "C" {
 #define GPIO_UART_TXD		(14)	// RPi Pin 10
 #define GPIO_UART_RXD		(13)	// RPi Pin 8
 
+/*
+ * websocket framing, selected by the client with /ws?codec=raw|lz4
+ *  text:   UART data as text frames (default)
+ *  binary: binary frames starting with a frame type byte
+ *  lz4:    binary frames, data compressed when it gets smaller
+ */
+typedef enum {
+	WS_MODE_TEXT = 0,
+	WS_MODE_BINARY,
+	WS_MODE_LZ4,
+} ws_mode_t;
+
+#define WS_FRAME_HDR_SIZE	(1)		// frame type
+#define WS_LZ4_HDR_SIZE		(3)		// frame type, raw length (LE16)
+#define WS_FRAME_DATA		(0x00)	// UART data as is
+#define WS_FRAME_DATA_LZ4	(0x01)	// UART data, LZ4 block
+
+/*
+ * control messages share the binary frames of the raw and lz4 modes with the
+ * data; they are handled at once, ahead of the data queued in either
+ * direction. Numbers are little endian.
+ * client to device:
+ */
+#define WS_CTRL_BREAK		(0x10)	// u16 duration in msec (0: break off)
+#define WS_CTRL_LINE		(0x11)	// u32 baud, u8 data bits (5-8),
+									//  u8 parity ('N', 'O', 'E'),
+									//  u8 stop bits (1, 2, 3: 1.5)
+#define WS_CTRL_POWER		(0x12)	// u8 1: wake up, 0: shut down
+#define WS_CTRL_QUERY		(0x13)	// request a state notification
+#define WS_CTRL_CREDIT		(0x14)	// u32 more bytes the client will take;
+									//  flow control is on after the first one
+#define WS_CTRL_RESIZE		(0x15)	// u16 columns, u16 rows
+/* device to client: */
+#define WS_CTRL_STATE		(0x80)	// u8 power (0, 1, 0xff: unknown),
+									//  u8 break, line as in WS_CTRL_LINE,
+									//  u16 columns, u16 rows,
+									//  u32 credit left (0xffffffff: no flow
+									//  control)
+#define WS_CTRL_STATE_SIZE	(1 + 2 + 7 + 4 + 4)
+#define WS_POWER_UNKNOWN	(0xff)
+#define WS_CREDIT_OFF		(0xffffffff)
+
+/*
+ * data path statistics, counted by several tasks: update them with
+ * STATS_ADD() and read them with stats_get(), 64 bit counters are not
+ * written atomically
+ */
+typedef struct _stats {
+	uint64_t uart_rx_bytes;		// bytes read from UART
+	uint64_t stream_dropped;	// bytes lost to a full stream buffer
+	uint64_t ws_frames;			// frames sent to the websocket
+	uint64_t ws_bytes;			// payload bytes sent to the websocket
+	uint64_t ws_held;			// frames that left a partial sequence behind
+	uint64_t ws_hold_expired;	// partial sequences sent as they were
+	uint64_t ws_binary;			// text mode frames sent as binary (not UTF-8)
+	uint64_t lz4_in;			// bytes given to the compressor
+	uint64_t lz4_out;			// payload bytes sent for them
+	uint64_t lz4_us;			// time spent compressing
+} stats_t;
+
+extern stats_t stats;
+extern portMUX_TYPE stats_lock;
+
+#define STATS_ADD(field, n)	do { \
+		portENTER_CRITICAL(&stats_lock); \
+		stats.field += (n); \
+		portEXIT_CRITICAL(&stats_lock); \
+	} while(0)
+
+void stats_get(stats_t *snapshot);
+
 esp_err_t start_rest_server(const char *base_path);
+void target_pwr_ctrl(int on);
 
 
 #ifdef __cplusplus
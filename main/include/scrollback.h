@@ -0,0 +1,67 @@
+#ifndef SCROLLBACK_H_
+#define SCROLLBACK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCROLLBACK_CHUNK_SIZE	(CONFIG_WEBTERM_SCROLLBACK_CHUNK_SIZE)
+#define SCROLLBACK_CHUNK_NUM	(CONFIG_WEBTERM_SCROLLBACK_CHUNK_NUM)
+#define SCROLLBACK_SIZE			(SCROLLBACK_CHUNK_SIZE * SCROLLBACK_CHUNK_NUM)
+#define SCROLLBACK_LINE_NUM		(CONFIG_WEBTERM_SCROLLBACK_LINE_NUM)
+#define SCROLLBACK_LINE_MAX		(256)	// longest line returned by search
+#define SCROLLBACK_MARKER_MAX	(16)	// number of markers (one tag bit each)
+#define SCROLLBACK_NEEDLE_MAX	(64)	// longest search string
+// structure sizes for ram_budget.cmake, checked in scrollback.c
+#define SCROLLBACK_LINE_SIZE	(12)	// scrollback_line_t
+#define SCROLLBACK_HIT_SIZE		(12)	// scrollback_hit_t
+
+/* line index entry: where a line starts and when it arrived */
+typedef struct {
+	uint32_t offset;		// absolute stream offset of the first byte
+	uint32_t time_ms;		// arrival time in msec since boot
+	uint16_t tags;			// bit n set: line contains marker n
+} scrollback_line_t;
+
+/* a search hit as returned by scrollback_search() */
+typedef struct {
+	uint32_t line;			// absolute line number
+	uint32_t time_ms;
+	uint16_t tags;
+} scrollback_hit_t;
+
+/* a piece of the ring as returned by scrollback_peek() */
+typedef struct {
+	const uint8_t *data;
+	size_t len;
+} scrollback_seg_t;
+
+esp_err_t scrollback_init(void);
+void scrollback_write(const uint8_t *data, size_t len);
+uint32_t scrollback_head(void);
+size_t scrollback_read(uint32_t *offset, uint8_t *buf, size_t size,
+		uint32_t *lost);
+size_t scrollback_peek(uint32_t *offset, size_t size, scrollback_seg_t seg[2],
+		uint32_t *lost);
+bool scrollback_valid(uint32_t offset);
+
+int scrollback_search(const char *needle, size_t needle_len, bool icase,
+		bool tagged_only, scrollback_hit_t *hits, int max_hits);
+int scrollback_get_line(uint32_t line, char *buf, size_t size,
+		scrollback_line_t *info);
+void scrollback_get_range(uint32_t *first, uint32_t *next);
+
+int scrollback_marker_count(void);
+const char *scrollback_marker_name(int idx);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCROLLBACK_H_
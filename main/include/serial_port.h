@@ -0,0 +1,35 @@
+#ifndef SERIAL_PORT_H_
+#define SERIAL_PORT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/uart.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* line settings of the target UART */
+typedef struct {
+	uint32_t baud_rate;
+	uart_word_length_t data_bits;
+	uart_parity_t parity;
+	uart_stop_bits_t stop_bits;
+} serial_line_t;
+
+/* called after the line settings or the break state changed */
+typedef void (*serial_port_cb_t)(void);
+
+void serial_port_set_callback(serial_port_cb_t cb);
+esp_err_t serial_port_get_line(serial_line_t *line);
+esp_err_t serial_port_set_line(const serial_line_t *line);
+esp_err_t serial_port_set_break(bool on);
+bool serial_port_get_break(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SERIAL_PORT_H_
@@ -0,0 +1,27 @@
+#ifndef SERIAL_SERVER_H_
+#define SERIAL_SERVER_H_
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SERIAL_CONN_MAX			(CONFIG_WEBTERM_SERIAL_CONN_MAX)
+#define SERIAL_TX_BUF_SIZE		(CONFIG_WEBTERM_SERIAL_TX_BUF_SIZE)
+#define SERIAL_RX_BUF_SIZE		(512)
+#define SERIAL_CTRL_RESERVE		(64)	// TX space kept for telnet replies
+#define SERIAL_SB_MAX			(16)	// longest telnet subnegotiation
+#define SERIAL_CONN_HDR_SIZE	(48)	// serial_conn_t but tx_buf, for the budget
+#define SERIAL_SERVER_STACK		(CONFIG_WEBTERM_SERIAL_SERVER_STACK)
+#define SERIAL_SERVER_PRIO		(5)
+
+esp_err_t start_serial_server(void);
+void serial_server_notify(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SERIAL_SERVER_H_
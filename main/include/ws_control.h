@@ -0,0 +1,26 @@
+#ifndef WS_CONTROL_H_
+#define WS_CONTROL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* called from any task when the clients should get a state notification */
+typedef void (*ws_control_notify_t)(void);
+
+esp_err_t ws_control_init(ws_control_notify_t notify);
+esp_err_t ws_control_handle(const uint8_t *msg, size_t len, uint32_t *credit);
+size_t ws_control_state(uint8_t *frame, uint32_t credit);
+void ws_control_set_power(uint8_t power);
+void ws_control_notify(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WS_CONTROL_H_
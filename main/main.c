@@ -13,6 +13,8 @@
 
 #include "main.h"
 #include "rest_server.h"
+#include "event_server.h"
+#include "serial_server.h"
 #include "wifi_manager.h"
 
 static const char *TAG = "main";
@@ -117,5 +119,13 @@ void app_main(void)
     ESP_ERROR_CHECK(init_fs());
 	// the server should start after init_fs
     ESP_ERROR_CHECK(start_rest_server(WEB_MOUNT_POINT));
+#if CONFIG_WEBTERM_SERIAL_SERVER
+	// shares the scrollback set up by the rest server
+    ESP_ERROR_CHECK(start_serial_server());
+#endif
+#if CONFIG_WEBTERM_ENGINE_EVENT
+	// serves the console and passes the rest on to the rest server
+    ESP_ERROR_CHECK(start_event_server());
+#endif
 }
 
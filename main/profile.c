@@ -0,0 +1,188 @@
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_idf_version.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "profile.h"
+
+static const char *TAG = "profile";
+
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 1, 0)
+#define xTaskGetIdleTaskHandleForCore(core)	xTaskGetIdleTaskHandleForCPU(core)
+#endif
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 3, 0)
+#define xTaskGetCoreID(task)				xTaskGetAffinity(task)
+#endif
+#ifndef configRUN_TIME_COUNTER_TYPE
+#define configRUN_TIME_COUNTER_TYPE			uint32_t
+#endif
+
+static const char *const s_heap_names[PROFILE_HEAP_NUM] = {
+	"internal", "dma", "8bit", "spiram",
+};
+static const uint32_t s_heap_caps[PROFILE_HEAP_NUM] = {
+	MALLOC_CAP_INTERNAL, MALLOC_CAP_DMA, MALLOC_CAP_8BIT, MALLOC_CAP_SPIRAM,
+};
+static const char *const s_state_names[] = {
+	"running", "ready", "blocked", "suspended", "deleted",
+};
+
+/* run time counters of the last sample, by task number */
+typedef struct {
+	UBaseType_t number;
+	configRUN_TIME_COUNTER_TYPE counter;
+} profile_prev_t;
+
+_Static_assert(sizeof(TaskStatus_t) + sizeof(profile_prev_t) <=
+		PROFILE_STATUS_SIZE && sizeof(profile_task_t) <= PROFILE_TASK_SIZE &&
+		sizeof(profile_sample_t) <=
+		PROFILE_SAMPLE_HDR_SIZE + PROFILE_TASK_MAX * PROFILE_TASK_SIZE,
+		"update the structure sizes in profile.h");
+
+static volatile uint32_t s_interval_ms;		// 0: stopped
+static TaskStatus_t s_status[PROFILE_TASK_MAX];
+static profile_prev_t s_prev[PROFILE_TASK_MAX];
+static int s_prev_num;
+static configRUN_TIME_COUNTER_TYPE s_prev_total;
+static profile_sample_t s_sample;			// the latest one
+static SemaphoreHandle_t s_lock;
+static StaticSemaphore_t s_lock_buf;
+static TaskHandle_t s_task;
+static StaticTask_t s_task_tcb;
+static StackType_t s_task_stack[PROFILE_TASK_STACK];
+
+
+/*
+ * run time spent since the last sample
+ */
+static configRUN_TIME_COUNTER_TYPE run_time_delta(const TaskStatus_t *st) {
+	for(int i = 0; i < s_prev_num; i++) {
+		if(s_prev[i].number == st->xTaskNumber) {
+			return st->ulRunTimeCounter - s_prev[i].counter;
+		}
+	}
+	// created since
+	return st->ulRunTimeCounter;
+}
+
+/*
+ * take a sample: task loads relative to the last one, stacks and heaps
+ */
+static void profile_sample(void) {
+	configRUN_TIME_COUNTER_TYPE total;
+	int64_t start = esp_timer_get_time();
+
+	// 0 if there are more tasks than PROFILE_TASK_MAX
+	UBaseType_t num = uxTaskGetSystemState(s_status, PROFILE_TASK_MAX, &total);
+	configRUN_TIME_COUNTER_TYPE elapsed = total - s_prev_total;
+	if(num == 0) {
+		ESP_LOGW(TAG, "more than %d tasks", PROFILE_TASK_MAX);
+	}
+
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	profile_sample_t *s = &s_sample;
+	for(int core = 0; core < portNUM_PROCESSORS; core++) {
+		s->core_load[core] = 0;
+	}
+	for(int i = 0; i < num; i++) {
+		const TaskStatus_t *st = &s_status[i];
+		profile_task_t *t = &s->task[i];
+		strlcpy(t->name, st->pcTaskName, sizeof(t->name));
+		BaseType_t core = xTaskGetCoreID(st->xHandle);
+		t->core = core < portNUM_PROCESSORS ? core : PROFILE_CORE_ANY;
+		t->priority = st->uxCurrentPriority;
+		t->state = st->eCurrentState;
+		t->cpu = elapsed ? (uint64_t)run_time_delta(st) * 10000 / elapsed : 0;
+		t->stack_free = st->usStackHighWaterMark;
+		// a core is busy when its idle task is not
+		for(int core = 0; core < portNUM_PROCESSORS; core++) {
+			if(st->xHandle == xTaskGetIdleTaskHandleForCore(core)) {
+				s->core_load[core] = t->cpu < 10000 ? 10000 - t->cpu : 0;
+			}
+		}
+		s_prev[i].number = st->xTaskNumber;
+		s_prev[i].counter = st->ulRunTimeCounter;
+	}
+	s_prev_num = num;
+	s_prev_total = total;
+	s->task_num = num;
+
+	for(int i = 0; i < PROFILE_HEAP_NUM; i++) {
+		multi_heap_info_t info;
+		heap_caps_get_info(&info, s_heap_caps[i]);
+		s->heap[i].total = info.total_free_bytes + info.total_allocated_bytes;
+		s->heap[i].free = info.total_free_bytes;
+		s->heap[i].largest = info.largest_free_block;
+		s->heap[i].min_free = info.minimum_free_bytes;
+	}
+
+	s->seq++;
+	s->interval_ms = elapsed / 1000;
+	s->time_ms = start / 1000;
+	s->sample_us = esp_timer_get_time() - start;
+	xSemaphoreGive(s_lock);
+}
+
+static void profile_task(void *pvParameters) {
+	while(1) {
+		uint32_t interval = s_interval_ms;
+		// woken up early when the interval is changed
+		ulTaskNotifyTake(pdTRUE, interval ?
+				pdMS_TO_TICKS(interval) : portMAX_DELAY);
+		if(s_interval_ms) {
+			profile_sample();
+		}
+	}
+}
+
+/*
+ * sample every interval_ms (0: stopped)
+ */
+esp_err_t profile_set_interval(uint32_t interval_ms) {
+	if(interval_ms && (interval_ms < PROFILE_INTERVAL_MIN ||
+			interval_ms > PROFILE_INTERVAL_MAX)) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	s_interval_ms = interval_ms;
+	xTaskNotifyGive(s_task);
+	ESP_LOGI(TAG, "interval %lu msec", (unsigned long)interval_ms);
+	return ESP_OK;
+}
+
+uint32_t profile_get_interval(void) {
+	return s_interval_ms;
+}
+
+/*
+ * copy of the latest sample
+ */
+void profile_get(profile_sample_t *sample) {
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	memcpy(sample, &s_sample, sizeof(*sample));
+	xSemaphoreGive(s_lock);
+}
+
+const char *profile_heap_name(profile_heap_id_t id) {
+	return s_heap_names[id];
+}
+
+const char *profile_state_name(uint8_t state) {
+	return state < sizeof(s_state_names) / sizeof(s_state_names[0]) ?
+		s_state_names[state] : "invalid";
+}
+
+/*
+ * set up the sampling task
+ */
+esp_err_t profile_init(uint32_t interval_ms) {
+	s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+	s_interval_ms = interval_ms;
+	s_task = xTaskCreateStatic(profile_task, "profile", PROFILE_TASK_STACK,
+			NULL, PROFILE_TASK_PRIO, s_task_stack, &s_task_tcb);
+	return s_task ? ESP_OK : ESP_FAIL;
+}
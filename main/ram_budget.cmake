@@ -0,0 +1,136 @@
+# Data path RAM budget
+#
+# Adds up the statically allocated buffers, rings and task stacks as sized in
+# menuconfig (plus the UART driver rings and the httpd stack, which are
+# allocated at start up), prints the report and fails the build when the total
+# exceeds CONFIG_WEBTERM_RAM_BUDGET.
+# The lwIP sockets the servers take are checked against CONFIG_LWIP_MAX_SOCKETS
+# the same way.
+# The fixed sizes are the "#define NAME (number)" lines of the headers the C
+# code is built with; the structure sizes there are checked at compile time.
+
+set(RAM_TOTAL 0)
+set(RAM_REPORT "")
+
+macro(ram_item name expr)
+    math(EXPR _ram_size "${expr}")
+    math(EXPR RAM_TOTAL "${RAM_TOTAL} + ${_ram_size}")
+    string(APPEND RAM_REPORT "\n    ${name}: ${_ram_size}")
+endmacro()
+
+# set a variable for each plain number defined in a header of include/
+macro(ram_defines header)
+    file(STRINGS "${CMAKE_CURRENT_LIST_DIR}/include/${header}" _ram_defs
+        REGEX "^#define[ \t]+[A-Z0-9_]+[ \t]+\\([0-9]+\\)")
+    foreach(_ram_def IN LISTS _ram_defs)
+        if(_ram_def MATCHES "^#define[ \t]+([A-Z0-9_]+)[ \t]+\\(([0-9]+)\\)")
+            set(${CMAKE_MATCH_1} ${CMAKE_MATCH_2})
+        endif()
+    endforeach()
+endmacro()
+
+foreach(_ram_header rest_server.h compress.h scrollback.h serial_server.h
+        event_server.h profile.h bench.h)
+    ram_defines(${_ram_header})
+    # read again when they change
+    set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS
+        "${CMAKE_CURRENT_LIST_DIR}/include/${_ram_header}")
+endforeach()
+
+set(UART_BUF ${CONFIG_WEBTERM_UART_BUF_SIZE})
+
+# UART and websocket
+ram_item("UART driver rings" "${UART_BUF} * 2")
+ram_item("UART read buffer" "${UART_BUF}")
+ram_item("UART to WS stream" "${CONFIG_WEBTERM_STREAM_BUF_SIZE} + 1")
+# LZ4_COMPRESS_BOUND() is fixed by the format
+ram_item("WS send buffers"
+    "${WS_FRAME_HDR_SIZE} + ${UART_BUF} + ${WS_LZ4_HDR_SIZE} + ${UART_BUF} + ${UART_BUF} / 255 + 16")
+ram_item("WS receive buffer" "${CONFIG_WEBTERM_WS_RX_BUF_SIZE} + 1")
+ram_item("HTTP scratch" "${CONFIG_WEBTERM_SCRATCH_BUF_SIZE}")
+ram_item("LZ4 match table" "(1 << ${LZ4_HASH_LOG}) * 2")
+
+# scrollback: ring, index entries, search results
+ram_item("scrollback ring"
+    "${CONFIG_WEBTERM_SCROLLBACK_CHUNK_SIZE} * ${CONFIG_WEBTERM_SCROLLBACK_CHUNK_NUM}")
+ram_item("scrollback index"
+    "${CONFIG_WEBTERM_SCROLLBACK_LINE_NUM} * ${SCROLLBACK_LINE_SIZE}")
+ram_item("search results"
+    "${SEARCH_HITS_MAX} * ${SCROLLBACK_HIT_SIZE} + ${SCROLLBACK_LINE_MAX}")
+
+# task stacks
+ram_item("uart_read_task stack" "${CONFIG_WEBTERM_UART_TASK_STACK}")
+ram_item("target_pwr_ctrl_task stack" "${PWR_TASK_STACK}")
+ram_item("httpd stack" "${CONFIG_WEBTERM_HTTPD_STACK}")
+
+# TCP sessions
+if(CONFIG_WEBTERM_SERIAL_SERVER)
+    set(TX_BUF ${CONFIG_WEBTERM_SERIAL_TX_BUF_SIZE})
+    ram_item("TCP sessions"
+        "${CONFIG_WEBTERM_SERIAL_CONN_MAX} * (${TX_BUF} + ${SERIAL_CONN_HDR_SIZE}) + 2 * ${SERIAL_RX_BUF_SIZE} + ${TX_BUF} / 2")
+    ram_item("serial_server stack" "${CONFIG_WEBTERM_SERIAL_SERVER_STACK}")
+endif()
+
+# event server connections, lz4 input buffer
+if(CONFIG_WEBTERM_ENGINE_EVENT)
+    set(EVENT_BUF ${CONFIG_WEBTERM_EVENT_BUF_SIZE})
+    ram_item("event server connections"
+        "${CONFIG_WEBTERM_EVENT_CONN_MAX} * (2 * ${EVENT_BUF} + ${EVENT_CONN_HDR_SIZE}) + ${EVENT_BUF}")
+    ram_item("event_server stack" "${CONFIG_WEBTERM_EVENT_SERVER_STACK}")
+endif()
+
+# profiler: task states, last counters, samples (served and latest)
+if(CONFIG_WEBTERM_PROFILE)
+    ram_item("profiler samples"
+        "${PROFILE_TASK_MAX} * ${PROFILE_STATUS_SIZE} + 2 * (${PROFILE_TASK_MAX} * ${PROFILE_TASK_SIZE} + ${PROFILE_SAMPLE_HDR_SIZE})")
+    ram_item("profile stack" "${PROFILE_TASK_STACK}")
+endif()
+
+# benchmark generator
+if(CONFIG_WEBTERM_BENCH)
+    ram_item("bench buffer" "${UART_BUF}")
+    ram_item("bench stack" "${BENCH_TASK_STACK}")
+endif()
+
+message(STATUS "Web terminal RAM budget:${RAM_REPORT}\n"
+    "    total: ${RAM_TOTAL} of ${CONFIG_WEBTERM_RAM_BUDGET} bytes")
+if(RAM_TOTAL GREATER CONFIG_WEBTERM_RAM_BUDGET)
+    message(FATAL_ERROR "Web terminal RAM budget exceeded: ${RAM_TOTAL} > "
+        "${CONFIG_WEBTERM_RAM_BUDGET}. Reduce the buffer sizes or raise the "
+        "budget in menuconfig (Web Terminal > Memory budget).")
+endif()
+
+# lwIP sockets: esp_http_server keeps 3 for itself besides its connections,
+# the serial port server has a listener per port, the event server a listener
+# and for each connection passed on to esp_http_server a second socket
+set(SOCK_TOTAL 0)
+set(SOCK_REPORT "")
+
+macro(sock_item name expr)
+    math(EXPR _sock_num "${expr}")
+    math(EXPR SOCK_TOTAL "${SOCK_TOTAL} + ${_sock_num}")
+    string(APPEND SOCK_REPORT "\n    ${name}: ${_sock_num}")
+endmacro()
+
+sock_item("esp_http_server" "3 + ${CONFIG_WEBTERM_HTTPD_CONN_MAX}")
+if(CONFIG_WEBTERM_SERIAL_SERVER)
+    set(_sock_ports 0)
+    if(CONFIG_WEBTERM_RAW_TCP_PORT)
+        math(EXPR _sock_ports "${_sock_ports} + 1")
+    endif()
+    if(CONFIG_WEBTERM_RFC2217_PORT)
+        math(EXPR _sock_ports "${_sock_ports} + 1")
+    endif()
+    sock_item("serial port server" "${_sock_ports} + ${CONFIG_WEBTERM_SERIAL_CONN_MAX}")
+endif()
+if(CONFIG_WEBTERM_ENGINE_EVENT)
+    sock_item("event server" "1 + 2 * ${CONFIG_WEBTERM_EVENT_CONN_MAX}")
+endif()
+
+message(STATUS "Web terminal sockets:${SOCK_REPORT}\n"
+    "    total: ${SOCK_TOTAL} of ${CONFIG_LWIP_MAX_SOCKETS}")
+if(SOCK_TOTAL GREATER CONFIG_LWIP_MAX_SOCKETS)
+    message(FATAL_ERROR "Web terminal sockets exceed LWIP_MAX_SOCKETS: "
+        "${SOCK_TOTAL} > ${CONFIG_LWIP_MAX_SOCKETS}. Lower the connection "
+        "limits or raise it in menuconfig (Component config > LWIP).")
+endif()
@@ -1,8 +1,10 @@
+#include <ctype.h>
 #include <string.h>
 #include <fcntl.h>
 #include "esp_http_server.h"
 #include "esp_chip_info.h"
 #include "esp_random.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 #include "esp_vfs.h"
 #include "driver/gpio.h"
@@ -10,14 +12,25 @@
 
 #include "cJSON.h"
 #include "freertos/FreeRTOS.h"
-//#include "freertos/semphr.h"
+#include "freertos/semphr.h"
 
+#include "bench.h"
+#include "chunker.h"
+#include "compress.h"
+#include "event_server.h"
+#include "profile.h"
 #include "rest_server.h"
+#include "scrollback.h"
+#include "serial_server.h"
+#include "ws_control.h"
 
 static const char *TAG = "rest_server";
 
 #define ECHO_TEST					(0)	// echo back test for websocket
 #define USE_STREAM_CALLBACK			(0)	// untested: try only when necessary
+// longer ws frames are read in pieces, a multiple of the 4 byte mask long:
+// httpd_ws_recv_frame() unmasks each read from the start of the mask
+#define WS_RX_PIECE					(WS_RX_BUF_SIZE & ~3)
 #define REST_CHECK(a, str, goto_tag, ...) \
     do { \
 		if (!(a)) { \
@@ -30,14 +43,32 @@ static const char *TAG = "rest_server";
 
 static esp_err_t init_hardware(void);
 static void ws_async_send(void *arg);
+#if CHUNK_HOLD_MS
+static void ws_hold_expired(void *arg);
+#endif
 static void target_pwr_ctrl_task(void *pvParameters);
 static void uart_read_task(void *pvParameters);
+static void console_rx(const uint8_t *data, int len);
+static void ws_send_state(void *arg);
+static void ws_state_changed(void);
+static void url_decode(char *str);
+static esp_err_t query_int(const char *query, const char *key, int *val);
 static esp_err_t set_content_type_from_file(httpd_req_t *req,
 		const char *filepath);
 /* REST endpoint handlers */
 static esp_err_t rest_common_get_handler(httpd_req_t *req);
 static esp_err_t power_post_handler(httpd_req_t *req);
 static esp_err_t power_get_handler(httpd_req_t *req);
+static esp_err_t search_get_handler(httpd_req_t *req);
+static esp_err_t stats_get_handler(httpd_req_t *req);
+#if CONFIG_WEBTERM_BENCH
+static esp_err_t bench_get_handler(httpd_req_t *req);
+static esp_err_t bench_post_handler(httpd_req_t *req);
+#endif
+#if CONFIG_WEBTERM_PROFILE
+static esp_err_t profile_get_handler(httpd_req_t *req);
+static esp_err_t profile_post_handler(httpd_req_t *req);
+#endif
 static esp_err_t websocket_handler(httpd_req_t *req);
 
 #if USE_STREAM_CALLBACK
@@ -55,12 +86,46 @@ typedef struct rest_server_context {
 typedef struct _resp_data {
     httpd_handle_t hd;
     int fd;
-	uint8_t data[UART_BUF_SIZE];
+	ws_mode_t mode;
+	uint32_t credit;			// bytes the client still takes, or WS_CREDIT_OFF
+	size_t held;				// bytes at the start of data left from the last frame
+	int64_t held_since;			// when they were held back
+	// data[0] is reserved for the frame type in binary modes
+	uint8_t data[WS_FRAME_HDR_SIZE + UART_BUF_SIZE];
+	uint8_t zbuf[WS_LZ4_HDR_SIZE + LZ4_COMPRESS_BOUND(UART_BUF_SIZE)];
 } resp_data_t;
 
-resp_data_t resp_arg;				// response data
+/*
+ * All data path objects are allocated statically and sized from Kconfig;
+ * see ram_budget.cmake for the budget check.
+ */
+static rest_server_context_t server_context;
+resp_data_t resp_arg = {				// response data
+	.credit = WS_CREDIT_OFF,
+};
+stats_t stats;						// data path statistics
+portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
 uint8_t uart_data[UART_BUF_SIZE];	// uart data
+static uint8_t ws_rx_buf[WS_RX_BUF_SIZE + 1];	// incoming ws frame piece, NUL terminated
 StreamBufferHandle_t xDataBuffer;	// stream buffer from UART to WS
+#if CHUNK_HOLD_MS
+static esp_timer_handle_t hold_timer;		// flushes held back bytes
+#endif
+static StaticStreamBuffer_t xDataBufferStruct;
+static uint8_t xDataBufferStorage[STREAM_BUF_SIZE + 1];
+static StaticTask_t uart_task_tcb;
+static StackType_t uart_task_stack[UART_TASK_STACK];
+static TaskHandle_t pwr_task;
+static StaticTask_t pwr_task_tcb;
+static StackType_t pwr_task_stack[PWR_TASK_STACK];
+#if CONFIG_WEBTERM_UART_PATTERN_DET
+static QueueHandle_t uart_queue;			// UART driver events
+#endif
+#if CONFIG_WEBTERM_BENCH
+// console_rx() is also called by the benchmark generator
+static SemaphoreHandle_t rx_lock;
+static StaticSemaphore_t rx_lock_buf;
+#endif
 
 
 
@@ -81,47 +146,68 @@ static esp_err_t init_hardware() {
 	ESP_ERROR_CHECK(uart_param_config(UART_PORT_NUM, &uart_config));
 	ESP_ERROR_CHECK(uart_set_pin(UART_PORT_NUM, GPIO_UART_TXD, GPIO_UART_RXD,
 				UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+#if CONFIG_WEBTERM_UART_PATTERN_DET
+	ESP_ERROR_CHECK(uart_driver_install(UART_PORT_NUM, UART_BUF_SIZE,
+				UART_BUF_SIZE, UART_QUEUE_SIZE, &uart_queue, 0));
+	// interrupt on every line feed so that complete lines are handed over
+	// (and tagged) as soon as they arrive
+	ESP_ERROR_CHECK(uart_enable_pattern_det_baud_intr(UART_PORT_NUM, '\n', 1,
+				9, 0, 0));
+	ESP_ERROR_CHECK(uart_pattern_queue_reset(UART_PORT_NUM, UART_QUEUE_SIZE));
+#else
 	ESP_ERROR_CHECK(uart_driver_install(UART_PORT_NUM, UART_BUF_SIZE,
 				UART_BUF_SIZE, 0, NULL, 0));
+#endif
 	return ESP_OK;
 }
 
 
 /*
- * power control task
+ * power control task: waits for a request (notification value 1: wake up,
+ * 0: shutdown) and pulses the control pin
  */
 static void target_pwr_ctrl_task(void *pvParameters) {
 	int gpio_pin;
+	uint32_t cmd;
 	gpio_config_t io_config = {};
 
-	if((int)pvParameters == 1) {
-		// wake up
-		gpio_pin = GPIO_PWR_WAKE;
-		ESP_LOGI(TAG, "waking up target");
-	} else {
-		// shutdown
-		gpio_pin = GPIO_PWR_SHDN;
-		ESP_LOGI(TAG, "shutting down target");
-	}
-
-	// set up the control pin
-	io_config.intr_type = GPIO_INTR_DISABLE;
-	io_config.mode = GPIO_MODE_OUTPUT;
-	io_config.pin_bit_mask = (1ULL << gpio_pin);
-	io_config.pull_down_en = 0;
-	io_config.pull_up_en = 1;	// prevent glitch ?
-	gpio_config(&io_config);
-
-	// 500 msec active low pulse
-	gpio_set_level(gpio_pin, 0);
-	vTaskDelay( 500 / portTICK_PERIOD_MS);
-	gpio_set_level(gpio_pin, 1);
+	while(1) {
+		xTaskNotifyWait(0, 0, &cmd, portMAX_DELAY);
+
+		if(cmd == 1) {
+			// wake up
+			gpio_pin = GPIO_PWR_WAKE;
+			ESP_LOGI(TAG, "waking up target");
+		} else {
+			// shutdown
+			gpio_pin = GPIO_PWR_SHDN;
+			ESP_LOGI(TAG, "shutting down target");
+		}
 
-	// reset the pin
-	gpio_reset_pin(gpio_pin);
+		// set up the control pin
+		io_config.intr_type = GPIO_INTR_DISABLE;
+		io_config.mode = GPIO_MODE_OUTPUT;
+		io_config.pin_bit_mask = (1ULL << gpio_pin);
+		io_config.pull_down_en = 0;
+		io_config.pull_up_en = 1;	// prevent glitch ?
+		gpio_config(&io_config);
+
+		// 500 msec active low pulse
+		gpio_set_level(gpio_pin, 0);
+		vTaskDelay( 500 / portTICK_PERIOD_MS);
+		gpio_set_level(gpio_pin, 1);
+
+		// reset the pin
+		gpio_reset_pin(gpio_pin);
+	}
+}
 
-	// kill itself
-	vTaskDelete(NULL);
+/*
+ * request a power control pulse: 1: wake up, 0: shutdown
+ */
+void target_pwr_ctrl(int on) {
+	xTaskNotify(pwr_task, on, eSetValueWithOverwrite);
+	ws_control_set_power(on);
 }
 
 /*
@@ -137,25 +223,202 @@ static void ws_async_send(void *arg)
 
 	httpd_handle_t hd = r->hd;
 	int fd = r->fd;
+	uint8_t *data = r->data + WS_FRAME_HDR_SIZE;
+
+	// whatever has piled up goes out as one frame, after the bytes held back
+	// (the work is queued after the data is pushed: no need to wait)
+	size_t room = UART_BUF_SIZE - r->held;
+	if(room > r->credit) {
+		// the rest waits in the stream until the client grants more
+		room = r->credit;
+	}
+	size_t len = room ?
+		xStreamBufferReceive(xDataBuffer, data + r->held, room, 0) : 0;
+	if(r->credit != WS_CREDIT_OFF) {
+		r->credit -= len;
+	}
+	len += r->held;
+	if(len == 0) {
+		return;
+	}
+	size_t send_len = len;
+#if CHUNK_HOLD_MS
+	// keep an incomplete code point or escape sequence for the next frame,
+	// for CHUNK_HOLD_MS at most
+	int64_t now = esp_timer_get_time();
+	if(r->held && now - r->held_since >= CHUNK_HOLD_MS * 1000) {
+		STATS_ADD(ws_hold_expired, 1);
+	} else {
+		send_len = chunk_boundary(data, len);
+	}
+	if(send_len < len && (r->held == 0 || send_len)) {
+		// a new partial sequence
+		r->held_since = now;
+		esp_timer_stop(hold_timer);
+		esp_timer_start_once(hold_timer, CHUNK_HOLD_MS * 1000);
+		STATS_ADD(ws_held, 1);
+	}
+	if(send_len == 0) {
+		r->held = len;
+		return;
+	}
+#endif
+	ESP_LOGD(TAG, "From Buffer: %.*s", (int)send_len, data);
+	ws_pkt.len = send_len;
+	ws_pkt.payload = data;
+
+	// browsers close the connection on a text frame that is not UTF-8
+	if(r->mode != WS_MODE_TEXT || !chunk_is_utf8(data, send_len)) {
+		if(r->mode == WS_MODE_TEXT) {
+			STATS_ADD(ws_binary, 1);
+		}
+		ws_pkt.type = HTTPD_WS_TYPE_BINARY;
+		r->data[0] = WS_FRAME_DATA;
+		ws_pkt.len = WS_FRAME_HDR_SIZE + send_len;
+		ws_pkt.payload = r->data;
+	}
 
-	int len = xStreamBufferReceive(xDataBuffer, r->data, sizeof(r->data),
-			(TickType_t) 10);
-	ws_pkt.len = len;
-	ws_pkt.payload = r->data;
-	ESP_LOGD(TAG, "From Buffer: %.*s", len, ws_pkt.payload);
+	if(r->mode == WS_MODE_LZ4) {
+		int64_t start = esp_timer_get_time();
+		size_t zlen = compress_lz4(data, send_len, r->zbuf + WS_LZ4_HDR_SIZE,
+				sizeof(r->zbuf) - WS_LZ4_HDR_SIZE);
+		STATS_ADD(lz4_us, esp_timer_get_time() - start);
+		// send it stored if it does not get any smaller
+		if(zlen && WS_LZ4_HDR_SIZE + zlen < ws_pkt.len) {
+			r->zbuf[0] = WS_FRAME_DATA_LZ4;
+			r->zbuf[1] = send_len & 0xff;
+			r->zbuf[2] = send_len >> 8;
+			ws_pkt.len = WS_LZ4_HDR_SIZE + zlen;
+			ws_pkt.payload = r->zbuf;
+		}
+		STATS_ADD(lz4_in, send_len);
+		STATS_ADD(lz4_out, ws_pkt.len);
+	}
+
+	STATS_ADD(ws_frames, 1);
+	STATS_ADD(ws_bytes, ws_pkt.len);
 	httpd_ws_send_frame_async(hd, fd, &ws_pkt);
+
+	// move the held back bytes (CHUNK_HOLD_MAX at most) to the front
+	r->held = len - send_len;
+	memmove(data, data + send_len, r->held);
+
+	// more than a frame was waiting: without new UART data nothing else
+	// sends the rest
+	if(xStreamBufferBytesAvailable(xDataBuffer) && r->credit) {
+		httpd_queue_work(hd, ws_async_send, r);
+	}
 }
 
+#if CHUNK_HOLD_MS
+/*
+ * hold timer callback: send the held back bytes if nothing completed them
+ */
+static void ws_hold_expired(void *arg) {
+	httpd_queue_work(resp_arg.hd, ws_async_send, (void *)&resp_arg);
+}
+#endif
+
+/*
+ * a client is attached to the httpd websocket
+ */
+static bool ws_attached(void) {
+	return resp_arg.hd && httpd_ws_get_fd_info(resp_arg.hd, resp_arg.fd) ==
+			HTTPD_WS_CLIENT_WEBSOCKET;
+}
 
+/*
+ * hand over UART data to the scrollback and the websocket
+ */
+static void console_rx(const uint8_t *data, int len) {
+	ESP_LOGD(TAG, "From UART: %.*s", len, data);
+#if CONFIG_WEBTERM_BENCH
+	xSemaphoreTake(rx_lock, portMAX_DELAY);
+#endif
+	STATS_ADD(uart_rx_bytes, len);
+	// keep history for the search
+	scrollback_write(data, len);
+#if CONFIG_WEBTERM_SERIAL_SERVER
+	// TCP clients read from the scrollback
+	serial_server_notify();
+#endif
+#if CONFIG_WEBTERM_ENGINE_EVENT
+	// so does the event server
+	event_server_notify();
+#endif
+	// nothing drains the stream without a /ws client, which is the usual
+	// case with the event server in front
+	if(ws_attached()) {
+		// push data into stream, without waiting: the UART driver ring would
+		// overflow meanwhile and the other readers lose data too
+		size_t sent = xStreamBufferSend(xDataBuffer, data, len, 0);
+		STATS_ADD(stream_dropped, len - sent);
+#if USE_STREAM_CALLBACK
+#else
+		// send data using httpd_queue_work
+		esp_err_t ret = httpd_queue_work(resp_arg.hd, ws_async_send,
+				(void *)&resp_arg);
+		if(ret != ESP_OK) {
+			ESP_LOGE(TAG, "httpd_queue_work failed");
+		}
+#endif
+	}
+#if CONFIG_WEBTERM_BENCH
+	xSemaphoreGive(rx_lock);
+#endif
+}
+
+#if CONFIG_WEBTERM_UART_PATTERN_DET
+/*
+ * UART incoming data handling driven by the driver events
+ */
+static void uart_read_task(void *pvParameters) {
+	uart_event_t event;
+	size_t avail;
+	int len;
+
+	while(1) {
+		if(xQueueReceive(uart_queue, &event, portMAX_DELAY) != pdTRUE) {
+			continue;
+		}
+
+		switch(event.type) {
+		case UART_DATA:
+		case UART_PATTERN_DET:
+			// a pattern event carries one complete line
+			len = (event.type == UART_PATTERN_DET) ?
+				uart_pattern_pop_pos(UART_PORT_NUM) + 1 : 0;
+			if(len <= 0) {
+				uart_get_buffered_data_len(UART_PORT_NUM, &avail);
+				len = avail;
+			}
+			if(len > UART_BUF_SIZE - 1) {
+				len = UART_BUF_SIZE - 1;
+			}
+			len = uart_read_bytes(UART_PORT_NUM, uart_data, len, 0);
+			if(len > 0) {
+				uart_data[len] = 0x00;
+				console_rx(uart_data, len);
+			}
+			break;
+		case UART_FIFO_OVF:
+		case UART_BUFFER_FULL:
+			ESP_LOGW(TAG, "UART overflow (%d)", event.type);
+			uart_flush_input(UART_PORT_NUM);
+			xQueueReset(uart_queue);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+#else
 /*
  * UART incoming data handling
  * FIXME: being a task, this could be turned into general UART event handler
  */
 static void uart_read_task(void *pvParameters) {
-    httpd_ws_frame_t ws_pkt;
-	memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
-	ws_pkt.type = HTTPD_WS_TYPE_TEXT;
-
 	while(1) {
 		// wait for UART RX input
 		int len = uart_read_bytes(UART_PORT_NUM, uart_data, (UART_BUF_SIZE -1),
@@ -164,21 +427,11 @@ static void uart_read_task(void *pvParameters) {
 		uart_data[len] = 0x00;
 
 		if(len) {
-			ESP_LOGD(TAG, "From UART: %.*s", len, uart_data);
-			// push data into stream
-			xStreamBufferSend(xDataBuffer, uart_data, len, (TickType_t) 10);
-#if USE_STREAM_CALLBACK
-#else
-			// send data using httpd_queue_work
-			esp_err_t ret = httpd_queue_work(resp_arg.hd, ws_async_send,
-					(void *)&resp_arg);
-			if(ret != ESP_OK) {
-				ESP_LOGE(TAG, "httpd_queue_work failed");
-			}
-#endif
+			console_rx(uart_data, len);
 		}
 	}
 }
+#endif
 
 #if USE_STREAM_CALLBACK
 /*
@@ -307,16 +560,12 @@ static esp_err_t power_post_handler(httpd_req_t *req)
 			strncmp((const char*)state, "ON", sizeof(state)) == 0 ||
 			strncmp((const char*)state, "On", sizeof(state)) == 0) {
 		httpd_resp_sendstr(req, "Waking up target device");
-		//target_pwr_ctrl(1);
-		xTaskCreate(target_pwr_ctrl_task, "target_pwr_ctrl_task", 2048,
-				(void*)1, 10, NULL);
+		target_pwr_ctrl(1);
 	} else if( strncmp((const char*)state, "off", sizeof(state)) == 0 ||
 			strncmp((const char*)state, "Off", sizeof(state)) == 0 ||
 			strncmp((const char*)state, "Off", sizeof(state)) == 0) {
 		httpd_resp_sendstr(req, "Shutting down target device");
-		//target_pwr_ctrl(0);
-		xTaskCreate(target_pwr_ctrl_task, "target_pwr_ctrl_task", 2048,
-				(void*)0, 10, NULL);
+		target_pwr_ctrl(0);
 	} else {
 		httpd_resp_sendstr(req, "Invalid power state detected");
 	}
@@ -343,6 +592,8 @@ static esp_err_t power_get_handler(httpd_req_t *req)
 	gpio_set_pull_mode(GPIO_UART_RXD, GPIO_PULLUP_ONLY);
 	// WARNING: you may get a garbage char like 0x00 due to the RXD disruption
 
+	ws_control_set_power(state);
+
 	// build json data
 	if(state == 1) {
 		cJSON_AddStringToObject(root, "power", "on");
@@ -360,6 +611,451 @@ static esp_err_t power_get_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+/*
+ * decode %XX and '+' of a query value in place
+ */
+static void url_decode(char *str) {
+	char *out = str;
+	while(*str) {
+		if(*str == '%' && isxdigit((int)str[1]) && isxdigit((int)str[2])) {
+			char hex[3] = { str[1], str[2], 0x00 };
+			*out++ = (char)strtol(hex, NULL, 16);
+			str += 3;
+		} else if(*str == '+') {
+			*out++ = ' ';
+			str++;
+		} else {
+			*out++ = *str++;
+		}
+	}
+	*out = 0x00;
+}
+
+/*
+ * add a context line to the array (skipped if it was evicted meanwhile)
+ */
+static void add_search_line(cJSON *array, uint32_t line, char *buf,
+		size_t size) {
+	if(scrollback_get_line(line, buf, size, NULL) >= 0) {
+		cJSON_AddItemToArray(array, cJSON_CreateString(buf));
+	}
+}
+
+/*
+ * integer value of a query key, *val is kept if the key is not there
+ */
+static esp_err_t query_int(const char *query, const char *key, int *val) {
+	char str[12];
+	esp_err_t err = httpd_query_key_value(query, key, str, sizeof(str));
+	if(err == ESP_OK) {
+		*val = atoi(str);
+	}
+	return err == ESP_ERR_NOT_FOUND ? ESP_OK : err;
+}
+
+/*
+ * handler: GET search the scrollback
+ *  q=<string>, icase=1, tagged=1, context=<lines>, max=<matches>
+ * The response is streamed one match at a time to keep the memory bounded.
+ */
+static esp_err_t search_get_handler(httpd_req_t *req)
+{
+	static scrollback_hit_t hits[SEARCH_HITS_MAX];
+	static char line_buf[SCROLLBACK_LINE_MAX];
+	char *query = ((rest_server_context_t *)(req->user_ctx))->scratch;
+	char needle[SCROLLBACK_NEEDLE_MAX * 3 + 1] = "";
+	int icase = 0;
+	int tagged = 0;
+	int context = 0;
+	int max_hits = SEARCH_HITS_MAX;
+
+	// a query or value cut short must not be searched for as it is
+	esp_err_t err = httpd_req_get_url_query_str(req, query, SCRATCH_BUFSIZE);
+	if(err == ESP_OK) {
+		err = httpd_query_key_value(query, "q", needle, sizeof(needle));
+		if((err != ESP_OK && err != ESP_ERR_NOT_FOUND) ||
+				query_int(query, "icase", &icase) != ESP_OK ||
+				query_int(query, "tagged", &tagged) != ESP_OK ||
+				query_int(query, "context", &context) != ESP_OK ||
+				query_int(query, "max", &max_hits) != ESP_OK) {
+			httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid query");
+			return ESP_FAIL;
+		}
+		url_decode(needle);
+		context = context < 0 ? 0 :
+			(context > SEARCH_CONTEXT_MAX ? SEARCH_CONTEXT_MAX : context);
+		max_hits = max_hits < 1 ? 1 :
+			(max_hits > SEARCH_HITS_MAX ? SEARCH_HITS_MAX : max_hits);
+	} else if(err != ESP_ERR_NOT_FOUND) {
+		httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid query");
+		return ESP_FAIL;
+	}
+	if(strlen(needle) > SCROLLBACK_NEEDLE_MAX) {
+		httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+				"Search string too long");
+		return ESP_FAIL;
+	}
+
+	int count = scrollback_search(needle, strlen(needle), icase, tagged, hits,
+			max_hits);
+	if(count < 0) {
+		httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+				"Invalid search string");
+		return ESP_FAIL;
+	}
+	ESP_LOGI(TAG, "Search \"%s\": %d matches", needle, count);
+
+	uint32_t first, next;
+	scrollback_get_range(&first, &next);
+
+	httpd_resp_set_type(req, "application/json");
+	httpd_resp_sendstr_chunk(req, "{\"matches\":[");
+	for(int i = 0; i < count; i++) {
+		cJSON *match = cJSON_CreateObject();
+		cJSON_AddNumberToObject(match, "line", hits[i].line);
+		cJSON_AddNumberToObject(match, "time", hits[i].time_ms);
+		cJSON *tags = cJSON_AddArrayToObject(match, "tags");
+		for(int t = 0; t < scrollback_marker_count(); t++) {
+			if(hits[i].tags & (1 << t)) {
+				cJSON_AddItemToArray(tags,
+						cJSON_CreateString(scrollback_marker_name(t)));
+			}
+		}
+		if(context) {
+			cJSON *before = cJSON_AddArrayToObject(match, "before");
+			for(uint32_t l = hits[i].line - context; l != hits[i].line; l++) {
+				if(l - first < next - first) {
+					add_search_line(before, l, line_buf, sizeof(line_buf));
+				}
+			}
+		}
+		if(scrollback_get_line(hits[i].line, line_buf, sizeof(line_buf), NULL)
+				>= 0) {
+			cJSON_AddStringToObject(match, "text", line_buf);
+		}
+		if(context) {
+			cJSON *after = cJSON_AddArrayToObject(match, "after");
+			for(uint32_t l = hits[i].line + 1;
+					l != hits[i].line + 1 + context && l != next; l++) {
+				add_search_line(after, l, line_buf, sizeof(line_buf));
+			}
+		}
+
+		char *str = cJSON_PrintUnformatted(match);
+		cJSON_Delete(match);
+		if(str == NULL) {
+			break;
+		}
+		if(i) {
+			httpd_resp_sendstr_chunk(req, ",");
+		}
+		httpd_resp_sendstr_chunk(req, str);
+		free(str);
+	}
+
+	snprintf(line_buf, sizeof(line_buf),
+			"],\"first\":%lu,\"next\":%lu,\"truncated\":%s}",
+			(unsigned long)first, (unsigned long)next,
+			count == max_hits ? "true" : "false");
+	httpd_resp_sendstr_chunk(req, line_buf);
+	httpd_resp_sendstr_chunk(req, NULL);
+
+	return ESP_OK;
+}
+
+/*
+ * consistent copy of the statistics
+ */
+void stats_get(stats_t *snapshot) {
+	portENTER_CRITICAL(&stats_lock);
+	*snapshot = stats;
+	portEXIT_CRITICAL(&stats_lock);
+}
+
+/*
+ * handler: GET data path statistics
+ */
+static esp_err_t stats_get_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/json");
+    cJSON *root = cJSON_CreateObject();
+	stats_t st;
+	stats_get(&st);
+
+	cJSON_AddNumberToObject(root, "uart_rx_bytes", st.uart_rx_bytes);
+	cJSON_AddNumberToObject(root, "stream_dropped", st.stream_dropped);
+	cJSON_AddNumberToObject(root, "ws_frames", st.ws_frames);
+	cJSON_AddNumberToObject(root, "ws_bytes", st.ws_bytes);
+	cJSON_AddNumberToObject(root, "ws_held", st.ws_held);
+	cJSON_AddNumberToObject(root, "ws_hold_expired", st.ws_hold_expired);
+	cJSON_AddNumberToObject(root, "ws_binary", st.ws_binary);
+	cJSON_AddStringToObject(root, "ws_mode",
+			resp_arg.mode == WS_MODE_LZ4 ? "lz4" :
+			(resp_arg.mode == WS_MODE_BINARY ? "raw" : "text"));
+
+	// compression ratio (in/out) and cost per KB of input
+	cJSON *lz4 = cJSON_AddObjectToObject(root, "lz4");
+	cJSON_AddNumberToObject(lz4, "in_bytes", st.lz4_in);
+	cJSON_AddNumberToObject(lz4, "out_bytes", st.lz4_out);
+	cJSON_AddNumberToObject(lz4, "ratio", st.lz4_out ?
+			(double)st.lz4_in / st.lz4_out : 0);
+	cJSON_AddNumberToObject(lz4, "cpu_us", st.lz4_us);
+	cJSON_AddNumberToObject(lz4, "us_per_kb", st.lz4_in ?
+			(double)st.lz4_us * 1024 / st.lz4_in : 0);
+
+    const char *str = cJSON_Print(root);
+    httpd_resp_sendstr(req, str);
+    free((void *)str);
+    cJSON_Delete(root);
+
+    return ESP_OK;
+}
+
+#if CONFIG_WEBTERM_BENCH
+/*
+ * send the benchmark status as JSON
+ */
+static esp_err_t bench_send_status(httpd_req_t *req)
+{
+	bench_status_t st;
+	bench_get_status(&st);
+
+    httpd_resp_set_type(req, "application/json");
+    cJSON *root = cJSON_CreateObject();
+	cJSON_AddStringToObject(root, "mode", bench_mode_name(st.config.mode));
+	cJSON_AddStringToObject(root, "pattern",
+			bench_pattern_name(st.config.pattern));
+	cJSON_AddNumberToObject(root, "rate", st.config.rate);
+	cJSON_AddNumberToObject(root, "records", st.records);
+	cJSON_AddNumberToObject(root, "bytes", st.bytes);
+	cJSON_AddNumberToObject(root, "elapsed_ms", st.elapsed_ms);
+
+    const char *str = cJSON_Print(root);
+    httpd_resp_sendstr(req, str);
+    free((void *)str);
+    cJSON_Delete(root);
+
+    return ESP_OK;
+}
+
+/*
+ * handler: GET benchmark status
+ */
+static esp_err_t bench_get_handler(httpd_req_t *req)
+{
+	return bench_send_status(req);
+}
+
+/*
+ * handler: POST benchmark control
+ *  {"mode": "generator"|"loopback"|"off", "pattern": "ascii"|"ansi"|"binary",
+ *   "rate": <bytes/sec, 0: unlimited>}
+ */
+static esp_err_t bench_post_handler(httpd_req_t *req)
+{
+    int total_len = req->content_len;
+    int cur_len = 0;
+    char *buf = ((rest_server_context_t *)(req->user_ctx))->scratch;
+    int received = 0;
+    if (total_len >= SCRATCH_BUFSIZE) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+				"content too long");
+        return ESP_FAIL;
+    }
+    while (cur_len < total_len) {
+        received = httpd_req_recv(req, buf + cur_len, total_len);
+        if (received <= 0) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+					"Failed to post benchmark settings");
+            return ESP_FAIL;
+        }
+        cur_len += received;
+    }
+    buf[total_len] = '\0';
+
+	bench_config_t config = {
+		.mode = BENCH_OFF,
+		.pattern = BENCH_PATTERN_ASCII,
+		.rate = 0,
+	};
+	int val;
+	bool valid = true;
+    cJSON *root = cJSON_Parse(buf);
+	cJSON *item = cJSON_GetObjectItem(root, "mode");
+	if(cJSON_IsString(item)) {
+		valid &= (val = bench_mode_from_name(item->valuestring)) >= 0;
+		config.mode = val;
+	}
+	item = cJSON_GetObjectItem(root, "pattern");
+	if(cJSON_IsString(item)) {
+		valid &= (val = bench_pattern_from_name(item->valuestring)) >= 0;
+		config.pattern = val;
+	}
+	item = cJSON_GetObjectItem(root, "rate");
+	if(cJSON_IsNumber(item)) {
+		valid &= item->valuedouble >= 0 && item->valuedouble <= BENCH_RATE_MAX;
+		config.rate = item->valuedouble;
+	}
+    cJSON_Delete(root);
+
+	if(!valid || bench_start(&config) != ESP_OK) {
+		httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+				"Invalid benchmark settings");
+		return ESP_FAIL;
+	}
+	return bench_send_status(req);
+}
+#endif
+
+#if CONFIG_WEBTERM_PROFILE
+/*
+ * send the latest profile sample as JSON
+ */
+static esp_err_t profile_send(httpd_req_t *req)
+{
+	static profile_sample_t sample;		// too large for the httpd stack
+	profile_get(&sample);
+
+    httpd_resp_set_type(req, "application/json");
+    cJSON *root = cJSON_CreateObject();
+	cJSON_AddNumberToObject(root, "interval_ms", profile_get_interval());
+	cJSON_AddNumberToObject(root, "seq", sample.seq);
+	cJSON_AddNumberToObject(root, "time_ms", sample.time_ms);
+	cJSON_AddNumberToObject(root, "elapsed_ms", sample.interval_ms);
+	cJSON_AddNumberToObject(root, "sample_us", sample.sample_us);
+
+	// load in % per core and per task (of one core)
+	cJSON *cores = cJSON_AddArrayToObject(root, "cores");
+	for(int i = 0; i < portNUM_PROCESSORS; i++) {
+		cJSON_AddItemToArray(cores,
+				cJSON_CreateNumber(sample.core_load[i] / 100.0));
+	}
+	cJSON *tasks = cJSON_AddArrayToObject(root, "tasks");
+	for(int i = 0; i < sample.task_num; i++) {
+		profile_task_t *t = &sample.task[i];
+		cJSON *task = cJSON_CreateObject();
+		cJSON_AddStringToObject(task, "name", t->name);
+		cJSON_AddNumberToObject(task, "core", t->core);
+		cJSON_AddNumberToObject(task, "priority", t->priority);
+		cJSON_AddStringToObject(task, "state", profile_state_name(t->state));
+		cJSON_AddNumberToObject(task, "cpu", t->cpu / 100.0);
+		cJSON_AddNumberToObject(task, "stack_free", t->stack_free);
+		cJSON_AddItemToArray(tasks, task);
+	}
+
+	cJSON *heap = cJSON_AddObjectToObject(root, "heap");
+	for(int i = 0; i < PROFILE_HEAP_NUM; i++) {
+		profile_heap_t *h = &sample.heap[i];
+		if(h->total == 0) {
+			continue;
+		}
+		cJSON *caps = cJSON_AddObjectToObject(heap, profile_heap_name(i));
+		cJSON_AddNumberToObject(caps, "total", h->total);
+		cJSON_AddNumberToObject(caps, "free", h->free);
+		cJSON_AddNumberToObject(caps, "largest", h->largest);
+		cJSON_AddNumberToObject(caps, "min_free", h->min_free);
+	}
+
+	// data waiting on its way between UART and WiFi, read now
+	size_t uart_rx = 0;
+	uart_get_buffered_data_len(UART_PORT_NUM, &uart_rx);
+	cJSON *queues = cJSON_AddObjectToObject(root, "queues");
+	cJSON_AddNumberToObject(queues, "uart_rx", uart_rx);
+	cJSON_AddNumberToObject(queues, "uart_rx_size", UART_BUF_SIZE);
+	cJSON_AddNumberToObject(queues, "stream",
+			xStreamBufferBytesAvailable(xDataBuffer));
+	cJSON_AddNumberToObject(queues, "stream_size", STREAM_BUF_SIZE);
+
+    const char *str = cJSON_Print(root);
+    httpd_resp_sendstr(req, str);
+    free((void *)str);
+    cJSON_Delete(root);
+
+    return ESP_OK;
+}
+
+/*
+ * handler: GET profile sample
+ */
+static esp_err_t profile_get_handler(httpd_req_t *req)
+{
+	return profile_send(req);
+}
+
+/*
+ * handler: POST profiler settings
+ *  {"interval_ms": <100 - 60000, 0: stop sampling>}
+ */
+static esp_err_t profile_post_handler(httpd_req_t *req)
+{
+    int total_len = req->content_len;
+    int cur_len = 0;
+    char *buf = ((rest_server_context_t *)(req->user_ctx))->scratch;
+    int received = 0;
+    if (total_len >= SCRATCH_BUFSIZE) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+				"content too long");
+        return ESP_FAIL;
+    }
+    while (cur_len < total_len) {
+        received = httpd_req_recv(req, buf + cur_len, total_len);
+        if (received <= 0) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+					"Failed to post profiler settings");
+            return ESP_FAIL;
+        }
+        cur_len += received;
+    }
+    buf[total_len] = '\0';
+
+	esp_err_t ret = ESP_ERR_INVALID_ARG;
+    cJSON *root = cJSON_Parse(buf);
+	cJSON *item = cJSON_GetObjectItem(root, "interval_ms");
+	if(cJSON_IsNumber(item) && item->valuedouble >= 0) {
+		ret = profile_set_interval(item->valuedouble);
+	}
+    cJSON_Delete(root);
+
+	if(ret != ESP_OK) {
+		httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+				"Invalid profiler settings");
+		return ESP_FAIL;
+	}
+	return profile_send(req);
+}
+#endif
+
+/*
+ * send a state notification (httpd work), binary modes only
+ */
+static void ws_send_state(void *arg) {
+	static uint8_t frame[WS_CTRL_STATE_SIZE];
+
+	if(resp_arg.mode == WS_MODE_TEXT) {
+		return;
+	}
+	httpd_ws_frame_t ws_pkt = {
+		.type = HTTPD_WS_TYPE_BINARY,
+		.payload = frame,
+		.len = ws_control_state(frame, resp_arg.credit),
+	};
+	if(ws_pkt.len) {
+		httpd_ws_send_frame_async(resp_arg.hd, resp_arg.fd, &ws_pkt);
+	}
+}
+
+/*
+ * tell the client about a change, from any task
+ */
+static void ws_state_changed(void) {
+	if(resp_arg.hd) {
+		httpd_queue_work(resp_arg.hd, ws_send_state, NULL);
+	}
+#if CONFIG_WEBTERM_ENGINE_EVENT
+	event_server_notify_state();
+#endif
+}
+
 /*
  * handler: websocket
  */
@@ -371,13 +1067,30 @@ static esp_err_t websocket_handler(httpd_req_t *req)
 		// set resp_arg params
 		resp_arg.hd = req->handle;
 		resp_arg.fd = httpd_req_to_sockfd(req);
+		resp_arg.held = 0;
+		resp_arg.credit = WS_CREDIT_OFF;
+		// framing requested by the client: /ws?codec=raw|lz4
+		char query[32], codec[8];
+		resp_arg.mode = WS_MODE_TEXT;
+		if(httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+				httpd_query_key_value(query, "codec", codec, sizeof(codec))
+				== ESP_OK) {
+			if(strcmp(codec, "lz4") == 0) {
+				resp_arg.mode = WS_MODE_LZ4;
+			} else if(strcmp(codec, "raw") == 0) {
+				resp_arg.mode = WS_MODE_BINARY;
+			}
+		}
+		ESP_LOGI(TAG, "Websocket mode: %d", resp_arg.mode);
+		// the state notification follows the handshake
+		ws_state_changed();
 
         return ESP_OK;
     }
 
 	// incoming ws packet handled here
     httpd_ws_frame_t ws_pkt;
-    uint8_t *buf = NULL;
+    uint8_t *buf = ws_rx_buf;
     memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
     ws_pkt.type = HTTPD_WS_TYPE_TEXT;
 
@@ -388,25 +1101,7 @@ static esp_err_t websocket_handler(httpd_req_t *req)
         return ret;
     }
 
-    ESP_LOGD(TAG, "frame len is %d", ws_pkt.len);
-    if (ws_pkt.len) {
-        /* ws_pkt.len + 1 is for NULL termination as we are expecting a string */
-        buf = calloc(1, ws_pkt.len + 1);
-        if (buf == NULL) {
-            ESP_LOGE(TAG, "Failed to calloc memory for buf");
-            return ESP_ERR_NO_MEM;
-        }
-        ws_pkt.payload = buf;
-        /* Set max_len = ws_pkt.len to get the frame payload */
-        ret = httpd_ws_recv_frame(req, &ws_pkt, ws_pkt.len);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "httpd_ws_recv_frame failed with %d", ret);
-            free(buf);
-            return ret;
-        }
-        ESP_LOGD(TAG, "Got packet with message: %s", ws_pkt.payload);
-    }
-
+    ESP_LOGD(TAG, "frame len is %d", (int)ws_pkt.len);
     ESP_LOGD(TAG, "Packet type: %d", ws_pkt.type);
 	/*
     if (ws_pkt.type == HTTPD_WS_TYPE_TEXT &&
@@ -416,18 +1111,62 @@ static esp_err_t websocket_handler(httpd_req_t *req)
     }
 	*/
 
+	// a longer frame (a paste) is read in pieces: handlers run one at a time
+	// on the httpd task, so one buffer will do
+	size_t left = ws_pkt.len;
+	bool first = true;
+	bool drop = false;			// the rest of a control message
+	do {
+		ws_pkt.len = left < WS_RX_PIECE ? left : WS_RX_PIECE;
+		ws_pkt.payload = buf;
+		if(ws_pkt.len) {
+			/* Set max_len = ws_pkt.len to get the frame payload */
+			ret = httpd_ws_recv_frame(req, &ws_pkt, ws_pkt.len);
+			if(ret != ESP_OK) {
+				ESP_LOGE(TAG, "httpd_ws_recv_frame failed with %d", ret);
+				return ret;
+			}
+		}
+		left -= ws_pkt.len;
+		buf[ws_pkt.len] = 0x00;
+		ESP_LOGD(TAG, "Got packet with message: %s", ws_pkt.payload);
+
 #if ECHO_TEST
-    ret = httpd_ws_send_frame(req, &ws_pkt);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "httpd_ws_send_frame failed with %d", ret);
-    }
+		ret = httpd_ws_send_frame(req, &ws_pkt);
+		if(ret != ESP_OK) {
+			ESP_LOGE(TAG, "httpd_ws_send_frame failed with %d", ret);
+		}
 #else
-	// send data to UART
-	uart_write_bytes(UART_PORT_NUM, (const char *)ws_pkt.payload, ws_pkt.len);
-
+		if(first && ws_pkt.type == HTTPD_WS_TYPE_BINARY &&
+				resp_arg.mode != WS_MODE_TEXT) {
+			// binary modes: frame type byte first
+			if(ws_pkt.len == 0) {
+				return ESP_OK;
+			} else if(buf[0] != WS_FRAME_DATA) {
+				// invalid ones are dropped, the connection stays
+				if(left) {
+					ESP_LOGW(TAG, "control message too long (%d)",
+							(int)(ws_pkt.len + left));
+				} else if(ws_control_handle(buf, ws_pkt.len, &resp_arg.credit)
+						== ESP_OK && buf[0] == WS_CTRL_CREDIT) {
+					// send what has been waiting for it
+					httpd_queue_work(req->handle, ws_async_send,
+							(void *)&resp_arg);
+				}
+				drop = true;
+			}
+			ws_pkt.payload++;
+			ws_pkt.len--;
+		}
+		first = false;
+		if(!drop) {
+			// send data to UART
+			uart_write_bytes(UART_PORT_NUM, (const char *)ws_pkt.payload,
+					ws_pkt.len);
+		}
 #endif
+	} while(left);
 
-    free(buf);
     return ret;
 }
 
@@ -438,33 +1177,64 @@ esp_err_t start_rest_server(const char *base_path)
 {
     REST_CHECK(base_path, "wrong base path", err);
 	ESP_ERROR_CHECK(init_hardware());
+	ESP_ERROR_CHECK(scrollback_init());
+#if CONFIG_WEBTERM_BENCH
+	rx_lock = xSemaphoreCreateMutexStatic(&rx_lock_buf);
+	ESP_ERROR_CHECK(bench_init(console_rx));
+#endif
+#if CONFIG_WEBTERM_PROFILE
+	ESP_ERROR_CHECK(profile_init(CONFIG_WEBTERM_PROFILE_INTERVAL_MS));
+#endif
 
 	// create a stream buffer
 #if USE_STREAM_CALLBACK
-	xDataBuffer = xStreamBufferCreateWithCallback(UART_BUF_SIZE * 2, 1,
-			vStreamSendCallback, NULL);
+	xDataBuffer = xStreamBufferCreateStaticWithCallback(STREAM_BUF_SIZE, 1,
+			xDataBufferStorage, &xDataBufferStruct, vStreamSendCallback, NULL);
 #else
-	xDataBuffer = xStreamBufferCreate(UART_BUF_SIZE * 2, 1);
+	xDataBuffer = xStreamBufferCreateStatic(STREAM_BUF_SIZE, 1,
+			xDataBufferStorage, &xDataBufferStruct);
+#endif
+
+#if CHUNK_HOLD_MS
+	const esp_timer_create_args_t hold_timer_args = {
+		.callback = ws_hold_expired,
+		.name = "ws_hold",
+	};
+	ESP_ERROR_CHECK(esp_timer_create(&hold_timer_args, &hold_timer));
 #endif
 
-    rest_server_context_t *rest_context = calloc(1, sizeof(rest_server_context_t));
-    REST_CHECK(rest_context, "No memory for rest context", err);
-    strlcpy(rest_context->base_path, base_path, sizeof(rest_context->base_path));
+	ESP_ERROR_CHECK(ws_control_init(ws_state_changed));
+
+    strlcpy(server_context.base_path, base_path,
+			sizeof(server_context.base_path));
+
+	// power control task waits for requests
+	pwr_task = xTaskCreateStatic(target_pwr_ctrl_task, "target_pwr_ctrl_task",
+			PWR_TASK_STACK, NULL, 10, pwr_task_stack, &pwr_task_tcb);
 
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.uri_match_fn = httpd_uri_match_wildcard;
+    config.stack_size = HTTPD_STACK;
+	// the default 8 are taken with the benchmark
+	config.max_uri_handlers = 12;
+	// counted in the socket budget, see ram_budget.cmake
+	config.max_open_sockets = CONFIG_WEBTERM_HTTPD_CONN_MAX;
+#if CONFIG_WEBTERM_ENGINE_EVENT
+	// behind the event server, which owns port 80
+	config.server_port = EVENT_HTTPD_PORT;
+#endif
 
     ESP_LOGI(TAG, "Starting HTTP Server");
     REST_CHECK(httpd_start(&server, &config) == ESP_OK, "Start server failed",
-			err_start);
+			err);
 
     // URI handler for power control
     httpd_uri_t power_post_uri = {
         .uri = "/api/v1/pwrctrl",
         .method = HTTP_POST,
         .handler = power_post_handler,
-        .user_ctx = rest_context
+        .user_ctx = &server_context
     };
     httpd_register_uri_handler(server, &power_post_uri);
 
@@ -473,16 +1243,70 @@ esp_err_t start_rest_server(const char *base_path)
         .uri = "/api/v1/pwrstate",
         .method = HTTP_GET,
         .handler = power_get_handler,
-        .user_ctx = rest_context
+        .user_ctx = &server_context
     };
     httpd_register_uri_handler(server, &power_get_uri);
 
+    // URI handler for scrollback search
+    httpd_uri_t search_get_uri = {
+        .uri = "/api/v1/search",
+        .method = HTTP_GET,
+        .handler = search_get_handler,
+        .user_ctx = &server_context
+    };
+    httpd_register_uri_handler(server, &search_get_uri);
+
+    // URI handler for statistics
+    httpd_uri_t stats_get_uri = {
+        .uri = "/api/v1/stats",
+        .method = HTTP_GET,
+        .handler = stats_get_handler,
+        .user_ctx = &server_context
+    };
+    httpd_register_uri_handler(server, &stats_get_uri);
+
+#if CONFIG_WEBTERM_BENCH
+    // URI handlers for the benchmark
+    httpd_uri_t bench_get_uri = {
+        .uri = "/api/v1/bench",
+        .method = HTTP_GET,
+        .handler = bench_get_handler,
+        .user_ctx = &server_context
+    };
+    httpd_register_uri_handler(server, &bench_get_uri);
+    httpd_uri_t bench_post_uri = {
+        .uri = "/api/v1/bench",
+        .method = HTTP_POST,
+        .handler = bench_post_handler,
+        .user_ctx = &server_context
+    };
+    httpd_register_uri_handler(server, &bench_post_uri);
+#endif
+
+#if CONFIG_WEBTERM_PROFILE
+    // URI handlers for the profiler
+    httpd_uri_t profile_get_uri = {
+        .uri = "/api/v1/profile",
+        .method = HTTP_GET,
+        .handler = profile_get_handler,
+        .user_ctx = &server_context
+    };
+    httpd_register_uri_handler(server, &profile_get_uri);
+    httpd_uri_t profile_post_uri = {
+        .uri = "/api/v1/profile",
+        .method = HTTP_POST,
+        .handler = profile_post_handler,
+        .user_ctx = &server_context
+    };
+    httpd_register_uri_handler(server, &profile_post_uri);
+#endif
+
 	// URI hander for websocket
     httpd_uri_t websocket_uri = {
         .uri = "/ws",
         .method = HTTP_GET,
         .handler = websocket_handler,
-        .user_ctx = rest_context,
+        .user_ctx = &server_context,
 		.is_websocket = true
     };
     httpd_register_uri_handler(server, &websocket_uri);
@@ -492,19 +1316,16 @@ esp_err_t start_rest_server(const char *base_path)
         .uri = "/*",
         .method = HTTP_GET,
         .handler = rest_common_get_handler,
-        .user_ctx = rest_context
+        .user_ctx = &server_context
     };
     httpd_register_uri_handler(server, &common_get_uri);
 
 	// create uart incoming task
-	xTaskCreate(uart_read_task, "uart_read_task", UART_BUF_SIZE + 1024,
-			NULL, 10, NULL);
+	xTaskCreateStatic(uart_read_task, "uart_read_task", UART_TASK_STACK,
+			NULL, 10, uart_task_stack, &uart_task_tcb);
 
     return ESP_OK;
 
-err_start:
-    free(rest_context);
-
 err:
     return ESP_FAIL;
 }
@@ -0,0 +1,491 @@
+#include <ctype.h>
+#include <string.h>
+#include "esp_log.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "scrollback.h"
+
+static const char *TAG = "scrollback";
+
+#define SCROLLBACK_MASK			(SCROLLBACK_SIZE - 1)
+#define NOT_FOUND				(UINT32_MAX)
+// true if any byte of the word is zero
+#define HAS_ZERO(v)				(((v) - 0x01010101UL) & ~(v) & 0x80808080UL)
+// true if any byte of the word equals b
+#define HAS_BYTE(v, b)			HAS_ZERO((v) ^ (0x01010101UL * (uint8_t)(b)))
+
+_Static_assert((SCROLLBACK_SIZE & SCROLLBACK_MASK) == 0,
+		"scrollback size must be a power of two");
+_Static_assert((SCROLLBACK_LINE_NUM & (SCROLLBACK_LINE_NUM - 1)) == 0,
+		"scrollback line count must be a power of two");
+_Static_assert(sizeof(scrollback_line_t) <= SCROLLBACK_LINE_SIZE &&
+		sizeof(scrollback_hit_t) <= SCROLLBACK_HIT_SIZE,
+		"update the structure sizes in scrollback.h");
+
+/* preprocessed search string */
+typedef struct {
+	const uint8_t *str;		// lower cased if icase
+	size_t len;
+	bool icase;
+	uint8_t lo;				// first byte, lower case
+	uint8_t up;				// first byte, upper case
+} needle_t;
+
+static void needle_init(needle_t *n, const uint8_t *str, size_t len,
+		bool icase);
+static const uint8_t *mem_find(const uint8_t *hay, size_t len,
+		const needle_t *n);
+static uint32_t ring_find(uint32_t start, uint32_t end, const needle_t *n);
+static uint32_t line_end(uint32_t line);
+static void open_line(uint32_t offset, uint32_t time_ms);
+static void close_line(uint32_t end);
+
+/*
+ * The store is a ring of fixed size chunks addressed by the absolute stream
+ * offset. When the writer enters a chunk holding old data the whole chunk is
+ * dropped, so the oldest valid offset (tail) is always chunk aligned.
+ */
+static uint8_t s_store[SCROLLBACK_CHUNK_NUM][SCROLLBACK_CHUNK_SIZE];
+static uint8_t *const s_ring = &s_store[0][0];
+static uint32_t s_head;				// next offset to be written
+static uint32_t s_tail;				// oldest valid offset
+
+/* line index: lines [s_first_line, s_next_line) are valid */
+static scrollback_line_t s_lines[SCROLLBACK_LINE_NUM];
+static uint32_t s_first_line;
+static uint32_t s_next_line;
+static bool s_at_bol = true;		// next byte starts a new line
+
+/* markers tagged on line completion */
+static char s_marker_buf[sizeof(CONFIG_WEBTERM_SCROLLBACK_MARKERS)];
+static needle_t s_markers[SCROLLBACK_MARKER_MAX];
+static int s_marker_num;
+
+static SemaphoreHandle_t s_lock;
+static StaticSemaphore_t s_lock_buf;
+
+#define LINE(n)		(s_lines[(n) & (SCROLLBACK_LINE_NUM - 1)])
+
+
+static void needle_init(needle_t *n, const uint8_t *str, size_t len,
+		bool icase) {
+	n->str = str;
+	n->len = len;
+	n->icase = icase;
+	n->lo = icase ? tolower(str[0]) : str[0];
+	n->up = icase ? toupper(str[0]) : str[0];
+}
+
+/*
+ * find the first occurrence of the needle in a contiguous buffer
+ *
+ * Candidates for the first byte are located a word at a time; only words
+ * that contain it are compared byte by byte.
+ */
+static const uint8_t *mem_find(const uint8_t *hay, size_t len,
+		const needle_t *n) {
+	if (n->len == 0 || len < n->len) {
+		return NULL;
+	}
+	size_t last = len - n->len;
+	size_t i = 0;
+
+	while (i <= last) {
+		size_t stop = i + 1;
+		if (last - i >= 3) {
+			uint32_t w;
+			memcpy(&w, hay + i, sizeof(w));
+			if (!HAS_BYTE(w, n->lo) && !HAS_BYTE(w, n->up)) {
+				i += 4;
+				continue;
+			}
+			stop = i + 4;
+		}
+		for (; i < stop; i++) {
+			if (hay[i] != n->lo && hay[i] != n->up) {
+				continue;
+			}
+			if (!n->icase) {
+				if (memcmp(hay + i + 1, n->str + 1, n->len - 1) == 0) {
+					return hay + i;
+				}
+			} else {
+				size_t k = 1;
+				while (k < n->len && tolower(hay[i + k]) == n->str[k]) {
+					k++;
+				}
+				if (k == n->len) {
+					return hay + i;
+				}
+			}
+		}
+	}
+	return NULL;
+}
+
+/*
+ * find the needle in the stream offsets [start, end), which may wrap around
+ * the end of the ring. Returns the offset of the match or NOT_FOUND.
+ */
+static uint32_t ring_find(uint32_t start, uint32_t end, const needle_t *n) {
+	uint32_t total = end - start;
+	uint32_t pos = start & SCROLLBACK_MASK;
+	uint32_t first = total < SCROLLBACK_SIZE - pos ?
+		total : SCROLLBACK_SIZE - pos;
+	const uint8_t *hit;
+
+	hit = mem_find(s_ring + pos, first, n);
+	if (hit) {
+		return start + (hit - (s_ring + pos));
+	}
+	if (first == total) {
+		return NOT_FOUND;
+	}
+
+	// matches straddling the end of the ring
+	if (n->len > 1) {
+		uint8_t seam[2 * (SCROLLBACK_NEEDLE_MAX - 1)];
+		uint32_t a = n->len - 1 < first ? n->len - 1 : first;
+		uint32_t b = n->len - 1 < total - first ? n->len - 1 : total - first;
+		memcpy(seam, s_ring + SCROLLBACK_SIZE - a, a);
+		memcpy(seam + a, s_ring, b);
+		hit = mem_find(seam, a + b, n);
+		if (hit) {
+			return start + first - a + (hit - seam);
+		}
+	}
+
+	hit = mem_find(s_ring, total - first, n);
+	if (hit) {
+		return start + first + (hit - s_ring);
+	}
+	return NOT_FOUND;
+}
+
+/*
+ * stream offset one past the last byte of the line
+ */
+static uint32_t line_end(uint32_t line) {
+	if (line + 1 == s_next_line) {
+		return s_head;
+	}
+	return LINE(line + 1).offset;
+}
+
+static void open_line(uint32_t offset, uint32_t time_ms) {
+	if (s_next_line - s_first_line == SCROLLBACK_LINE_NUM) {
+		// index full: forget the oldest line
+		s_first_line++;
+	}
+	scrollback_line_t *l = &LINE(s_next_line);
+	l->offset = offset;
+	l->time_ms = time_ms;
+	l->tags = 0;
+	s_next_line++;
+}
+
+/*
+ * the open line is complete: tag it with the markers it contains
+ */
+static void close_line(uint32_t end) {
+	uint32_t line = s_next_line - 1;
+	if (s_next_line == s_first_line) {
+		// evicted while still open
+		return;
+	}
+	scrollback_line_t *l = &LINE(line);
+	for (int i = 0; i < s_marker_num; i++) {
+		if (ring_find(l->offset, end, &s_markers[i]) != NOT_FOUND) {
+			l->tags |= (1 << i);
+		}
+	}
+	if (l->tags) {
+		ESP_LOGD(TAG, "line %lu tagged 0x%04x", (unsigned long)line, l->tags);
+	}
+}
+
+
+/*
+ * initialize the store and parse the marker list
+ */
+esp_err_t scrollback_init(void) {
+	s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+
+	// comma separated list of markers
+	strlcpy(s_marker_buf, CONFIG_WEBTERM_SCROLLBACK_MARKERS,
+			sizeof(s_marker_buf));
+	char *save = NULL;
+	for (char *tok = strtok_r(s_marker_buf, ",", &save);
+			tok && s_marker_num < SCROLLBACK_MARKER_MAX;
+			tok = strtok_r(NULL, ",", &save)) {
+		while (*tok == ' ') {
+			tok++;
+		}
+		size_t len = strlen(tok);
+		while (len && tok[len - 1] == ' ') {
+			tok[--len] = 0x00;
+		}
+		if (len == 0 || len > SCROLLBACK_NEEDLE_MAX) {
+			ESP_LOGW(TAG, "ignoring marker \"%s\"", tok);
+			continue;
+		}
+		needle_init(&s_markers[s_marker_num++], (const uint8_t *)tok, len,
+				false);
+	}
+	ESP_LOGI(TAG, "%d bytes in %d chunks, %d lines, %d markers",
+			SCROLLBACK_SIZE, SCROLLBACK_CHUNK_NUM, SCROLLBACK_LINE_NUM,
+			s_marker_num);
+	return ESP_OK;
+}
+
+/*
+ * append captured data to the store and update the line index
+ */
+void scrollback_write(const uint8_t *data, size_t len) {
+	uint32_t now = esp_log_timestamp();
+
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	while (len) {
+		// never more than a chunk at a time so that eviction stays simple
+		size_t n = len < SCROLLBACK_CHUNK_SIZE ? len : SCROLLBACK_CHUNK_SIZE;
+		uint32_t base = s_head;
+
+		// drop the chunks about to be overwritten
+		if (s_head + n - s_tail > SCROLLBACK_SIZE) {
+			s_tail = (s_head + n - SCROLLBACK_SIZE + SCROLLBACK_CHUNK_SIZE - 1)
+				& ~(uint32_t)(SCROLLBACK_CHUNK_SIZE - 1);
+			while (s_first_line != s_next_line &&
+					(int32_t)(LINE(s_first_line).offset - s_tail) < 0) {
+				s_first_line++;
+			}
+		}
+
+		// copy into the ring
+		uint32_t pos = s_head & SCROLLBACK_MASK;
+		size_t first = n < SCROLLBACK_SIZE - pos ? n : SCROLLBACK_SIZE - pos;
+		memcpy(s_ring + pos, data, first);
+		memcpy(s_ring, data + first, n - first);
+		s_head += n;
+
+		// line bookkeeping
+		const uint8_t *p = data;
+		const uint8_t *end = data + n;
+		while (p < end) {
+			if (s_at_bol) {
+				open_line(base + (p - data), now);
+				s_at_bol = false;
+			}
+			const uint8_t *nl = memchr(p, '\n', end - p);
+			if (nl == NULL) {
+				break;
+			}
+			close_line(base + (nl - data) + 1);
+			s_at_bol = true;
+			p = nl + 1;
+		}
+
+		data += n;
+		len -= n;
+	}
+	xSemaphoreGive(s_lock);
+}
+
+/*
+ * stream offset of the next byte to be written
+ */
+uint32_t scrollback_head(void) {
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	uint32_t head = s_head;
+	xSemaphoreGive(s_lock);
+	return head;
+}
+
+/*
+ * copy stored data from *offset on and advance it, for readers following
+ * the stream at their own pace. If the data at *offset was dropped already
+ * the reader skips to the oldest data and the number of bytes skipped is
+ * added to *lost.
+ */
+size_t scrollback_read(uint32_t *offset, uint8_t *buf, size_t size,
+		uint32_t *lost) {
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	if ((int32_t)(*offset - s_tail) < 0) {
+		if (lost) {
+			*lost += s_tail - *offset;
+		}
+		*offset = s_tail;
+	}
+	size_t len = s_head - *offset;
+	if (len > size) {
+		len = size;
+	}
+	uint32_t pos = *offset & SCROLLBACK_MASK;
+	size_t first = len < SCROLLBACK_SIZE - pos ? len : SCROLLBACK_SIZE - pos;
+	memcpy(buf, s_ring + pos, first);
+	memcpy(buf + first, s_ring, len - first);
+	*offset += len;
+	xSemaphoreGive(s_lock);
+
+	return len;
+}
+
+/*
+ * zero copy access for senders: the ring segments (at most 2) holding up to
+ * size bytes from *offset, which is moved over lost data as in
+ * scrollback_read() but not past the data returned.
+ * The data may be overwritten once it is older than the tail: check
+ * scrollback_valid() after it has been used.
+ */
+size_t scrollback_peek(uint32_t *offset, size_t size, scrollback_seg_t seg[2],
+		uint32_t *lost) {
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	if ((int32_t)(*offset - s_tail) < 0) {
+		if (lost) {
+			*lost += s_tail - *offset;
+		}
+		*offset = s_tail;
+	}
+	size_t len = s_head - *offset;
+	if (len > size) {
+		len = size;
+	}
+	uint32_t pos = *offset & SCROLLBACK_MASK;
+	size_t first = len < SCROLLBACK_SIZE - pos ? len : SCROLLBACK_SIZE - pos;
+	seg[0].data = s_ring + pos;
+	seg[0].len = first;
+	seg[1].data = s_ring;
+	seg[1].len = len - first;
+	xSemaphoreGive(s_lock);
+
+	return len;
+}
+
+/*
+ * whether the data from offset on is still in the ring
+ */
+bool scrollback_valid(uint32_t offset) {
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	bool valid = (int32_t)(offset - s_tail) >= 0;
+	xSemaphoreGive(s_lock);
+	return valid;
+}
+
+/*
+ * search the stored lines
+ *
+ * Each matching line is reported once. With tagged_only set only lines
+ * carrying a marker tag are reported, and the needle may then be empty.
+ * Returns the number of hits stored, or -1 on invalid arguments.
+ */
+int scrollback_search(const char *needle, size_t needle_len, bool icase,
+		bool tagged_only, scrollback_hit_t *hits, int max_hits) {
+	uint8_t lower[SCROLLBACK_NEEDLE_MAX];
+	needle_t n;
+	int count = 0;
+
+	if (needle_len > SCROLLBACK_NEEDLE_MAX ||
+			(needle_len == 0 && !tagged_only)) {
+		return -1;
+	}
+	if (icase) {
+		for (size_t i = 0; i < needle_len; i++) {
+			lower[i] = tolower((uint8_t)needle[i]);
+		}
+		needle = (const char *)lower;
+	}
+	if (needle_len) {
+		needle_init(&n, (const uint8_t *)needle, needle_len, icase);
+	}
+
+	// one line at a time so that the writer is not held up by a long scan,
+	// up to the lines stored when the search started: a busy writer would
+	// otherwise keep it going
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	uint32_t line = s_first_line;
+	uint32_t last = s_next_line;
+	xSemaphoreGive(s_lock);
+	while (count < max_hits) {
+		xSemaphoreTake(s_lock, portMAX_DELAY);
+		// lines are dropped from the index as their data leaves the ring
+		if ((int32_t)(line - s_first_line) < 0) {
+			// dropped while the lock was released: go on with the oldest
+			line = s_first_line;
+		}
+		if ((int32_t)(last - line) <= 0) {
+			xSemaphoreGive(s_lock);
+			break;
+		}
+		bool hit = tagged_only ? LINE(line).tags != 0 : true;
+		if (hit && needle_len) {
+			// a match starting in this line, it may run into the next one
+			uint32_t end = line_end(line) + needle_len - 1;
+			if ((int32_t)(end - s_head) > 0) {
+				end = s_head;
+			}
+			hit = ring_find(LINE(line).offset, end, &n) != NOT_FOUND;
+		}
+		if (hit) {
+			hits[count].line = line;
+			hits[count].time_ms = LINE(line).time_ms;
+			hits[count++].tags = LINE(line).tags;
+		}
+		xSemaphoreGive(s_lock);
+		line++;
+	}
+
+	return count;
+}
+
+/*
+ * copy a line without its line ending into buf (NUL terminated, truncated
+ * to fit). Returns the length copied or -1 if the line is no longer stored.
+ */
+int scrollback_get_line(uint32_t line, char *buf, size_t size,
+		scrollback_line_t *info) {
+	int len = -1;
+
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	if (line - s_first_line < s_next_line - s_first_line) {
+		uint32_t start = LINE(line).offset;
+		uint32_t end = line_end(line);
+		while (end != start &&
+				(s_ring[(end - 1) & SCROLLBACK_MASK] == '\n' ||
+				 s_ring[(end - 1) & SCROLLBACK_MASK] == '\r')) {
+			end--;
+		}
+		len = end - start < size - 1 ? end - start : size - 1;
+		for (int i = 0; i < len; i++) {
+			buf[i] = s_ring[(start + i) & SCROLLBACK_MASK];
+		}
+		buf[len] = 0x00;
+		if (info) {
+			*info = LINE(line);
+		}
+	}
+	xSemaphoreGive(s_lock);
+
+	return len;
+}
+
+/*
+ * lines [first, next) are currently stored
+ */
+void scrollback_get_range(uint32_t *first, uint32_t *next) {
+	xSemaphoreTake(s_lock, portMAX_DELAY);
+	*first = s_first_line;
+	*next = s_next_line;
+	xSemaphoreGive(s_lock);
+}
+
+int scrollback_marker_count(void) {
+	return s_marker_num;
+}
+
+const char *scrollback_marker_name(int idx) {
+	if (idx < 0 || idx >= s_marker_num) {
+		return NULL;
+	}
+	return (const char *)s_markers[idx].str;
+}
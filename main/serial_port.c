@@ -0,0 +1,99 @@
+#include "esp_log.h"
+#include "driver/uart.h"
+
+#include "rest_server.h"
+#include "serial_port.h"
+
+static const char *TAG = "serial_port";
+
+static bool s_break;
+static serial_port_cb_t s_callback;
+
+
+void serial_port_set_callback(serial_port_cb_t cb) {
+	s_callback = cb;
+}
+
+/*
+ * read back the current line settings from the driver
+ */
+esp_err_t serial_port_get_line(serial_line_t *line) {
+	esp_err_t ret = uart_get_baudrate(UART_PORT_NUM, &line->baud_rate);
+	if(ret == ESP_OK) {
+		ret = uart_get_word_length(UART_PORT_NUM, &line->data_bits);
+	}
+	if(ret == ESP_OK) {
+		ret = uart_get_parity(UART_PORT_NUM, &line->parity);
+	}
+	if(ret == ESP_OK) {
+		ret = uart_get_stop_bits(UART_PORT_NUM, &line->stop_bits);
+	}
+	return ret;
+}
+
+/*
+ * change the line settings; nothing is changed if any value is invalid
+ */
+esp_err_t serial_port_set_line(const serial_line_t *line) {
+	if(line->baud_rate < SERIAL_BAUD_MIN || line->baud_rate > SERIAL_BAUD_MAX ||
+			line->data_bits > UART_DATA_8_BITS ||
+			(line->parity != UART_PARITY_DISABLE &&
+			 line->parity != UART_PARITY_EVEN &&
+			 line->parity != UART_PARITY_ODD) ||
+			line->stop_bits < UART_STOP_BITS_1 ||
+			line->stop_bits > UART_STOP_BITS_2) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	esp_err_t ret = uart_set_baudrate(UART_PORT_NUM, line->baud_rate);
+	if(ret == ESP_OK) {
+		ret = uart_set_word_length(UART_PORT_NUM, line->data_bits);
+	}
+	if(ret == ESP_OK) {
+		ret = uart_set_parity(UART_PORT_NUM, line->parity);
+	}
+	if(ret == ESP_OK) {
+		ret = uart_set_stop_bits(UART_PORT_NUM, line->stop_bits);
+	}
+	if(ret != ESP_OK) {
+		return ret;
+	}
+	ESP_LOGI(TAG, "line set to %lu %d%c%s", (unsigned long)line->baud_rate,
+			line->data_bits + 5,
+			line->parity == UART_PARITY_EVEN ? 'E' :
+			(line->parity == UART_PARITY_ODD ? 'O' : 'N'),
+			line->stop_bits == UART_STOP_BITS_1 ? "1" :
+			(line->stop_bits == UART_STOP_BITS_2 ? "2" : "1.5"));
+	if(s_callback) {
+		s_callback();
+	}
+	return ESP_OK;
+}
+
+/*
+ * hold the TX line in the space (break) condition
+ *
+ * The driver only sends fixed length breaks after data, so the break state
+ * is emulated by inverting the idle TX level. It starts at once, like the
+ * other control messages it does not wait for the data still in the TX ring
+ * (a character being sent is cut short): the callers serve other clients.
+ */
+esp_err_t serial_port_set_break(bool on) {
+	if(on == s_break) {
+		return ESP_OK;
+	}
+	esp_err_t ret = uart_set_line_inverse(UART_PORT_NUM,
+			on ? UART_SIGNAL_TXD_INV : UART_SIGNAL_INV_DISABLE);
+	if(ret == ESP_OK) {
+		s_break = on;
+		ESP_LOGI(TAG, "break %s", on ? "on" : "off");
+		if(s_callback) {
+			s_callback();
+		}
+	}
+	return ret;
+}
+
+bool serial_port_get_break(void) {
+	return s_break;
+}
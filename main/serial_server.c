@@ -0,0 +1,650 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_vfs_eventfd.h"
+#include "lwip/sockets.h"
+#include "driver/uart.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "rest_server.h"
+#include "scrollback.h"
+#include "serial_port.h"
+#include "serial_server.h"
+
+static const char *TAG = "serial_server";
+
+/* telnet commands (RFC 854) */
+#define TN_IAC					(255)
+#define TN_DONT					(254)
+#define TN_DO					(253)
+#define TN_WONT					(252)
+#define TN_WILL					(251)
+#define TN_SB					(250)
+#define TN_SE					(240)
+/* telnet options */
+#define TN_OPT_BINARY			(0)
+#define TN_OPT_ECHO				(1)
+#define TN_OPT_SGA				(3)
+#define TN_OPT_COM_PORT			(44)
+
+/* RFC 2217 commands; the server answers with command + 100 */
+#define CP_SET_BAUDRATE			(1)
+#define CP_SET_DATASIZE			(2)
+#define CP_SET_PARITY			(3)
+#define CP_SET_STOPSIZE			(4)
+#define CP_SET_CONTROL			(5)
+#define CP_FLOWCONTROL_SUSPEND	(8)
+#define CP_FLOWCONTROL_RESUME	(9)
+#define CP_SET_LINESTATE_MASK	(10)
+#define CP_SET_MODEMSTATE_MASK	(11)
+#define CP_PURGE_DATA			(12)
+#define CP_SERVER				(100)
+
+/* SET-CONTROL values */
+#define CP_CTRL_FLOW_QUERY		(0)
+#define CP_CTRL_FLOW_NONE		(1)
+#define CP_CTRL_FLOW_HW			(3)
+#define CP_CTRL_BREAK_QUERY		(4)
+#define CP_CTRL_BREAK_ON		(5)
+#define CP_CTRL_BREAK_OFF		(6)
+#define CP_CTRL_DTR_QUERY		(7)
+#define CP_CTRL_DTR_ON			(8)
+#define CP_CTRL_DTR_OFF			(9)
+#define CP_CTRL_RTS_QUERY		(10)
+#define CP_CTRL_RTS_ON			(11)
+#define CP_CTRL_RTS_OFF			(12)
+#define CP_CTRL_INFLOW_QUERY	(13)
+#define CP_CTRL_INFLOW_NONE		(14)
+#define CP_CTRL_INFLOW_HW		(16)
+
+/* telnet option bits tracked per connection */
+#define OPT_BINARY				(1 << 0)
+#define OPT_ECHO				(1 << 1)
+#define OPT_SGA					(1 << 2)
+#define OPT_COM_PORT			(1 << 3)
+#define OPT_LOCAL				(OPT_BINARY | OPT_ECHO | OPT_SGA)
+#define OPT_REMOTE				(OPT_BINARY | OPT_SGA | OPT_COM_PORT)
+
+typedef enum {
+	TN_STATE_DATA,
+	TN_STATE_IAC,
+	TN_STATE_OPT,
+	TN_STATE_SB,
+	TN_STATE_SB_IAC,
+} tn_state_t;
+
+/* client connection */
+typedef struct {
+	int fd;					// -1 if the slot is free
+	bool rfc2217;			// telnet framing, otherwise raw
+	bool suspended;			// FLOWCONTROL-SUSPEND received
+	uint32_t offset;		// next capture offset to send
+	uint32_t lost;			// capture bytes dropped while the client lagged
+	size_t tx_len;			// bytes in tx_buf
+	size_t tx_pos;			// bytes of tx_buf already sent
+	tn_state_t tn_state;
+	uint8_t tn_verb;
+	uint8_t opt_local;		// options enabled on our side
+	uint8_t opt_remote;		// options enabled on the client side
+	uint8_t sb_len;
+	uint8_t sb_buf[SERIAL_SB_MAX];
+	uint8_t tx_buf[SERIAL_TX_BUF_SIZE];
+} serial_conn_t;
+
+_Static_assert(offsetof(serial_conn_t, tx_buf) <= SERIAL_CONN_HDR_SIZE,
+		"update SERIAL_CONN_HDR_SIZE");
+
+static serial_conn_t s_conn[SERIAL_CONN_MAX];
+static int s_conn_num;
+static uint8_t s_rx_buf[SERIAL_RX_BUF_SIZE];		// from a client
+static uint8_t s_uart_buf[SERIAL_RX_BUF_SIZE];		// to UART, telnet removed
+static uint8_t s_tmp[SERIAL_TX_BUF_SIZE / 2];		// capture data to escape
+static int s_event_fd = -1;							// new capture data
+static StaticTask_t s_task_tcb;
+static StackType_t s_task_stack[SERIAL_SERVER_STACK];
+// modem lines are not wired: their state is only remembered
+static bool s_dtr = true;
+static bool s_rts = true;
+
+static void serial_server_task(void *pvParameters);
+
+
+static uint8_t opt_bit(uint8_t opt) {
+	switch(opt) {
+	case TN_OPT_BINARY:
+		return OPT_BINARY;
+	case TN_OPT_ECHO:
+		return OPT_ECHO;
+	case TN_OPT_SGA:
+		return OPT_SGA;
+	case TN_OPT_COM_PORT:
+		return OPT_COM_PORT;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * queue bytes for the client; only used for the short telnet replies, for
+ * which SERIAL_CTRL_RESERVE is kept free
+ */
+static void conn_put(serial_conn_t *c, const uint8_t *data, size_t len) {
+	if(c->tx_len + len > sizeof(c->tx_buf)) {
+		ESP_LOGW(TAG, "fd %d: reply dropped", c->fd);
+		return;
+	}
+	memcpy(c->tx_buf + c->tx_len, data, len);
+	c->tx_len += len;
+}
+
+static void tn_send_opt(serial_conn_t *c, uint8_t verb, uint8_t opt) {
+	uint8_t cmd[] = { TN_IAC, verb, opt };
+	conn_put(c, cmd, sizeof(cmd));
+}
+
+/*
+ * option negotiation: only state changes are answered, so that the two
+ * sides never loop
+ */
+static void tn_negotiate(serial_conn_t *c, uint8_t verb, uint8_t opt) {
+	uint8_t bit = opt_bit(opt);
+
+	switch(verb) {
+	case TN_DO:
+		if(!(bit & OPT_LOCAL)) {
+			tn_send_opt(c, TN_WONT, opt);
+		} else if(!(c->opt_local & bit)) {
+			c->opt_local |= bit;
+			tn_send_opt(c, TN_WILL, opt);
+		}
+		break;
+	case TN_DONT:
+		if(c->opt_local & bit) {
+			c->opt_local &= ~bit;
+			tn_send_opt(c, TN_WONT, opt);
+		}
+		break;
+	case TN_WILL:
+		if(!(bit & OPT_REMOTE)) {
+			tn_send_opt(c, TN_DONT, opt);
+		} else if(!(c->opt_remote & bit)) {
+			c->opt_remote |= bit;
+			tn_send_opt(c, TN_DO, opt);
+		}
+		break;
+	case TN_WONT:
+		if(c->opt_remote & bit) {
+			c->opt_remote &= ~bit;
+			tn_send_opt(c, TN_DONT, opt);
+		}
+		break;
+	}
+}
+
+/*
+ * answer a COM-PORT-OPTION command with the value now in effect
+ */
+static void cp_reply(serial_conn_t *c, uint8_t cmd, const uint8_t *val,
+		size_t len) {
+	uint8_t buf[4 + 2 * 4 + 2];
+	size_t n = 0;
+
+	buf[n++] = TN_IAC;
+	buf[n++] = TN_SB;
+	buf[n++] = TN_OPT_COM_PORT;
+	buf[n++] = cmd + CP_SERVER;
+	for(size_t i = 0; i < len && i < 4; i++) {
+		buf[n++] = val[i];
+		if(val[i] == TN_IAC) {
+			buf[n++] = TN_IAC;
+		}
+	}
+	buf[n++] = TN_IAC;
+	buf[n++] = TN_SE;
+	conn_put(c, buf, n);
+}
+
+static uint8_t cp_control(serial_conn_t *c, uint8_t v) {
+	switch(v) {
+	case CP_CTRL_FLOW_QUERY:
+	case CP_CTRL_FLOW_NONE:
+	case CP_CTRL_FLOW_HW:
+		// RTS/CTS are not wired: no flow control whatever is asked
+		return CP_CTRL_FLOW_NONE;
+	case CP_CTRL_BREAK_ON:
+	case CP_CTRL_BREAK_OFF:
+		serial_port_set_break(v == CP_CTRL_BREAK_ON);
+		// fall through
+	case CP_CTRL_BREAK_QUERY:
+		return serial_port_get_break() ? CP_CTRL_BREAK_ON : CP_CTRL_BREAK_OFF;
+	case CP_CTRL_DTR_ON:
+	case CP_CTRL_DTR_OFF:
+		s_dtr = (v == CP_CTRL_DTR_ON);
+		// fall through
+	case CP_CTRL_DTR_QUERY:
+		return s_dtr ? CP_CTRL_DTR_ON : CP_CTRL_DTR_OFF;
+	case CP_CTRL_RTS_ON:
+	case CP_CTRL_RTS_OFF:
+		s_rts = (v == CP_CTRL_RTS_ON);
+		// fall through
+	case CP_CTRL_RTS_QUERY:
+		return s_rts ? CP_CTRL_RTS_ON : CP_CTRL_RTS_OFF;
+	case CP_CTRL_INFLOW_QUERY:
+	case CP_CTRL_INFLOW_HW:
+		return CP_CTRL_INFLOW_NONE;
+	default:
+		return v;
+	}
+}
+
+/*
+ * handle a complete COM-PORT-OPTION subnegotiation (RFC 2217)
+ */
+static void cp_handle(serial_conn_t *c) {
+	if(c->sb_len < 3 || c->sb_buf[0] != TN_OPT_COM_PORT) {
+		return;
+	}
+	uint8_t cmd = c->sb_buf[1];
+	uint8_t *val = &c->sb_buf[2];
+	size_t len = c->sb_len - 2;
+	serial_line_t line;
+	uint8_t reply[4];
+
+	serial_port_get_line(&line);
+	switch(cmd) {
+	case CP_SET_BAUDRATE:
+		if(len >= 4) {
+			uint32_t baud = ((uint32_t)val[0] << 24) | (val[1] << 16) |
+				(val[2] << 8) | val[3];
+			if(baud) {
+				line.baud_rate = baud;
+				serial_port_set_line(&line);
+				serial_port_get_line(&line);
+			}
+		}
+		reply[0] = line.baud_rate >> 24;
+		reply[1] = line.baud_rate >> 16;
+		reply[2] = line.baud_rate >> 8;
+		reply[3] = line.baud_rate;
+		cp_reply(c, cmd, reply, 4);
+		break;
+	case CP_SET_DATASIZE:
+		if(val[0] >= 5 && val[0] <= 8) {
+			line.data_bits = UART_DATA_5_BITS + (val[0] - 5);
+			serial_port_set_line(&line);
+			serial_port_get_line(&line);
+		}
+		reply[0] = 5 + (line.data_bits - UART_DATA_5_BITS);
+		cp_reply(c, cmd, reply, 1);
+		break;
+	case CP_SET_PARITY:
+		// 1: none, 2: odd, 3: even (mark and space are not supported)
+		if(val[0] >= 1 && val[0] <= 3) {
+			line.parity = val[0] == 2 ? UART_PARITY_ODD :
+				(val[0] == 3 ? UART_PARITY_EVEN : UART_PARITY_DISABLE);
+			serial_port_set_line(&line);
+			serial_port_get_line(&line);
+		}
+		reply[0] = line.parity == UART_PARITY_ODD ? 2 :
+			(line.parity == UART_PARITY_EVEN ? 3 : 1);
+		cp_reply(c, cmd, reply, 1);
+		break;
+	case CP_SET_STOPSIZE:
+		// 1: one, 2: two, 3: one and a half
+		if(val[0] >= 1 && val[0] <= 3) {
+			line.stop_bits = val[0] == 2 ? UART_STOP_BITS_2 :
+				(val[0] == 3 ? UART_STOP_BITS_1_5 : UART_STOP_BITS_1);
+			serial_port_set_line(&line);
+			serial_port_get_line(&line);
+		}
+		reply[0] = line.stop_bits == UART_STOP_BITS_2 ? 2 :
+			(line.stop_bits == UART_STOP_BITS_1_5 ? 3 : 1);
+		cp_reply(c, cmd, reply, 1);
+		break;
+	case CP_SET_CONTROL:
+		reply[0] = cp_control(c, val[0]);
+		cp_reply(c, cmd, reply, 1);
+		break;
+	case CP_FLOWCONTROL_SUSPEND:
+	case CP_FLOWCONTROL_RESUME:
+		c->suspended = (cmd == CP_FLOWCONTROL_SUSPEND);
+		break;
+	case CP_SET_LINESTATE_MASK:
+	case CP_SET_MODEMSTATE_MASK:
+		cp_reply(c, cmd, val, 1);
+		break;
+	case CP_PURGE_DATA:
+		// 1: data received from the port, 2: data to it, 3: both
+		if(val[0] & 1) {
+			c->offset = scrollback_head();
+			c->tx_len = c->tx_pos = 0;
+		}
+		cp_reply(c, cmd, val, 1);
+		break;
+	default:
+		ESP_LOGD(TAG, "fd %d: COM-PORT command %d ignored", c->fd, cmd);
+		break;
+	}
+}
+
+/*
+ * strip the telnet protocol from the client data and act on it
+ * returns the number of data bytes left in out
+ */
+static size_t tn_parse(serial_conn_t *c, const uint8_t *in, size_t len,
+		uint8_t *out) {
+	size_t n = 0;
+
+	for(size_t i = 0; i < len; i++) {
+		uint8_t b = in[i];
+		switch(c->tn_state) {
+		case TN_STATE_DATA:
+			if(b == TN_IAC) {
+				c->tn_state = TN_STATE_IAC;
+			} else {
+				out[n++] = b;
+			}
+			break;
+		case TN_STATE_IAC:
+			if(b == TN_IAC) {
+				out[n++] = b;
+				c->tn_state = TN_STATE_DATA;
+			} else if(b >= TN_WILL && b <= TN_DONT) {
+				c->tn_verb = b;
+				c->tn_state = TN_STATE_OPT;
+			} else if(b == TN_SB) {
+				c->sb_len = 0;
+				c->tn_state = TN_STATE_SB;
+			} else {
+				// NOP, AYT, ...
+				c->tn_state = TN_STATE_DATA;
+			}
+			break;
+		case TN_STATE_OPT:
+			tn_negotiate(c, c->tn_verb, b);
+			c->tn_state = TN_STATE_DATA;
+			break;
+		case TN_STATE_SB:
+			if(b == TN_IAC) {
+				c->tn_state = TN_STATE_SB_IAC;
+			} else if(c->sb_len < sizeof(c->sb_buf)) {
+				c->sb_buf[c->sb_len++] = b;
+			}
+			break;
+		case TN_STATE_SB_IAC:
+			if(b == TN_IAC) {
+				if(c->sb_len < sizeof(c->sb_buf)) {
+					c->sb_buf[c->sb_len++] = b;
+				}
+				c->tn_state = TN_STATE_SB;
+			} else {
+				if(b == TN_SE) {
+					cp_handle(c);
+				}
+				c->tn_state = TN_STATE_DATA;
+			}
+			break;
+		}
+	}
+	return n;
+}
+
+/*
+ * move new capture data into the TX buffer
+ */
+static void conn_fill(serial_conn_t *c) {
+	uint32_t lost = c->lost;
+
+	if(c->tx_pos) {
+		memmove(c->tx_buf, c->tx_buf + c->tx_pos, c->tx_len - c->tx_pos);
+		c->tx_len -= c->tx_pos;
+		c->tx_pos = 0;
+	}
+	if(c->suspended ||
+			c->tx_len + SERIAL_CTRL_RESERVE >= sizeof(c->tx_buf)) {
+		return;
+	}
+	size_t space = sizeof(c->tx_buf) - SERIAL_CTRL_RESERVE - c->tx_len;
+
+	if(!c->rfc2217) {
+		c->tx_len += scrollback_read(&c->offset, c->tx_buf + c->tx_len, space,
+				&c->lost);
+	} else {
+		// IAC is doubled, so take no more than what fits if all of it is
+		size_t n = scrollback_read(&c->offset, s_tmp,
+				space / 2 < sizeof(s_tmp) ? space / 2 : sizeof(s_tmp),
+				&c->lost);
+		for(size_t i = 0; i < n; i++) {
+			c->tx_buf[c->tx_len++] = s_tmp[i];
+			if(s_tmp[i] == TN_IAC) {
+				c->tx_buf[c->tx_len++] = TN_IAC;
+			}
+		}
+	}
+	if(c->lost != lost) {
+		ESP_LOGW(TAG, "fd %d: too slow, %lu bytes lost", c->fd,
+				(unsigned long)(c->lost - lost));
+	}
+}
+
+static void conn_close(serial_conn_t *c) {
+	ESP_LOGI(TAG, "fd %d: closed", c->fd);
+	close(c->fd);
+	c->fd = -1;
+	s_conn_num--;
+}
+
+/*
+ * send as much as the socket takes without blocking
+ */
+static void conn_pump(serial_conn_t *c) {
+	conn_fill(c);
+	while(c->tx_pos < c->tx_len) {
+		int n = send(c->fd, c->tx_buf + c->tx_pos, c->tx_len - c->tx_pos,
+				MSG_DONTWAIT);
+		if(n < 0) {
+			if(errno != EAGAIN && errno != EWOULDBLOCK) {
+				conn_close(c);
+			}
+			// otherwise wait until the socket is writable again
+			return;
+		}
+		c->tx_pos += n;
+		if(c->tx_pos == c->tx_len) {
+			conn_fill(c);
+		}
+	}
+}
+
+/*
+ * data from the client goes to the UART
+ */
+static void conn_recv(serial_conn_t *c) {
+	int n = recv(c->fd, s_rx_buf, sizeof(s_rx_buf), MSG_DONTWAIT);
+	if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+		conn_close(c);
+		return;
+	}
+	if(n < 0) {
+		return;
+	}
+
+	const uint8_t *data = s_rx_buf;
+	if(c->rfc2217) {
+		n = tn_parse(c, s_rx_buf, n, s_uart_buf);
+		data = s_uart_buf;
+	}
+	if(n) {
+		uart_write_bytes(UART_PORT_NUM, (const char *)data, n);
+	}
+}
+
+static void conn_accept(int listen_fd, bool rfc2217) {
+	int fd = accept(listen_fd, NULL, NULL);
+	if(fd < 0) {
+		return;
+	}
+
+	serial_conn_t *c = NULL;
+	for(int i = 0; i < SERIAL_CONN_MAX; i++) {
+		if(s_conn[i].fd < 0) {
+			c = &s_conn[i];
+			break;
+		}
+	}
+	if(c == NULL) {
+		ESP_LOGW(TAG, "too many connections");
+		close(fd);
+		return;
+	}
+
+	int opt = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+	memset(c, 0, offsetof(serial_conn_t, tx_buf));
+	c->fd = fd;
+	c->rfc2217 = rfc2217;
+	// start with live data
+	c->offset = scrollback_head();
+	s_conn_num++;
+	ESP_LOGI(TAG, "fd %d: %s client connected", fd, rfc2217 ? "RFC 2217" : "raw");
+
+	if(rfc2217) {
+		// offered up front; the client answers with DO/WILL or refuses
+		c->opt_local = OPT_BINARY | OPT_ECHO | OPT_SGA;
+		c->opt_remote = OPT_BINARY | OPT_SGA;
+		tn_send_opt(c, TN_WILL, TN_OPT_ECHO);
+		tn_send_opt(c, TN_WILL, TN_OPT_SGA);
+		tn_send_opt(c, TN_WILL, TN_OPT_BINARY);
+		tn_send_opt(c, TN_DO, TN_OPT_SGA);
+		tn_send_opt(c, TN_DO, TN_OPT_BINARY);
+	}
+}
+
+static int listen_on(uint16_t port) {
+	if(port == 0) {
+		return -1;
+	}
+
+	int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+	if(fd < 0) {
+		ESP_LOGE(TAG, "socket failed (%d)", errno);
+		return -1;
+	}
+	int opt = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_ANY),
+	};
+	if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+			listen(fd, SERIAL_CONN_MAX) != 0) {
+		ESP_LOGE(TAG, "failed to listen on port %d (%d)", port, errno);
+		close(fd);
+		return -1;
+	}
+	ESP_LOGI(TAG, "listening on port %d", port);
+	return fd;
+}
+
+/*
+ * single task serving all connections with select()
+ */
+static void serial_server_task(void *pvParameters) {
+	int listen_raw = listen_on(CONFIG_WEBTERM_RAW_TCP_PORT);
+	int listen_rfc = listen_on(CONFIG_WEBTERM_RFC2217_PORT);
+	fd_set rfds, wfds;
+
+	while(1) {
+		int max_fd = s_event_fd;
+		FD_ZERO(&rfds);
+		FD_ZERO(&wfds);
+		FD_SET(s_event_fd, &rfds);
+		if(listen_raw >= 0) {
+			FD_SET(listen_raw, &rfds);
+			max_fd = listen_raw > max_fd ? listen_raw : max_fd;
+		}
+		if(listen_rfc >= 0) {
+			FD_SET(listen_rfc, &rfds);
+			max_fd = listen_rfc > max_fd ? listen_rfc : max_fd;
+		}
+		for(int i = 0; i < SERIAL_CONN_MAX; i++) {
+			serial_conn_t *c = &s_conn[i];
+			if(c->fd < 0) {
+				continue;
+			}
+			FD_SET(c->fd, &rfds);
+			if(c->tx_pos < c->tx_len) {
+				FD_SET(c->fd, &wfds);
+			}
+			max_fd = c->fd > max_fd ? c->fd : max_fd;
+		}
+
+		if(select(max_fd + 1, &rfds, &wfds, NULL, NULL) < 0) {
+			ESP_LOGE(TAG, "select failed (%d)", errno);
+			vTaskDelay(100 / portTICK_PERIOD_MS);
+			continue;
+		}
+
+		if(FD_ISSET(s_event_fd, &rfds)) {
+			uint64_t count;
+			read(s_event_fd, &count, sizeof(count));
+		}
+		if(listen_raw >= 0 && FD_ISSET(listen_raw, &rfds)) {
+			conn_accept(listen_raw, false);
+		}
+		if(listen_rfc >= 0 && FD_ISSET(listen_rfc, &rfds)) {
+			conn_accept(listen_rfc, true);
+		}
+		for(int i = 0; i < SERIAL_CONN_MAX; i++) {
+			if(s_conn[i].fd >= 0 && FD_ISSET(s_conn[i].fd, &rfds)) {
+				conn_recv(&s_conn[i]);
+			}
+			// new capture data, replies or room in the socket
+			if(s_conn[i].fd >= 0) {
+				conn_pump(&s_conn[i]);
+			}
+		}
+	}
+}
+
+
+/*
+ * wake up the server: new data in the capture store
+ */
+void serial_server_notify(void) {
+	if(s_conn_num > 0) {
+		uint64_t count = 1;
+		write(s_event_fd, &count, sizeof(count));
+	}
+}
+
+/*
+ * start the raw TCP and RFC 2217 listeners
+ */
+esp_err_t start_serial_server(void) {
+	esp_vfs_eventfd_config_t config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+	esp_err_t ret = esp_vfs_eventfd_register(&config);
+	if(ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+		ESP_LOGE(TAG, "eventfd registration failed (%s)", esp_err_to_name(ret));
+		return ret;
+	}
+	s_event_fd = eventfd(0, 0);
+	if(s_event_fd < 0) {
+		ESP_LOGE(TAG, "eventfd failed (%d)", errno);
+		return ESP_FAIL;
+	}
+
+	for(int i = 0; i < SERIAL_CONN_MAX; i++) {
+		s_conn[i].fd = -1;
+	}
+	xTaskCreateStatic(serial_server_task, "serial_server", SERIAL_SERVER_STACK,
+			NULL, SERIAL_SERVER_PRIO, s_task_stack, &s_task_tcb);
+	return ESP_OK;
+}
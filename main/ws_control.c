@@ -0,0 +1,174 @@
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/uart.h"
+
+#include "rest_server.h"
+#include "serial_port.h"
+#include "ws_control.h"
+
+static const char *TAG = "ws_control";
+
+static ws_control_notify_t s_notify;
+static esp_timer_handle_t s_break_timer;	// ends a break sent by a client
+static uint8_t s_power = WS_POWER_UNKNOWN;	// as last set or read
+static uint16_t s_cols, s_rows;				// terminal size reported last
+
+
+/*
+ * little endian fields of the control messages
+ */
+static inline uint16_t get_le16(const uint8_t *p) {
+	return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t get_le32(const uint8_t *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void put_le16(uint8_t *p, uint16_t v) {
+	p[0] = v & 0xff;
+	p[1] = v >> 8;
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v) {
+	put_le16(p, v & 0xffff);
+	put_le16(p + 2, v >> 16);
+}
+
+static void break_end(void *arg) {
+	serial_port_set_break(false);
+}
+
+/*
+ * tell the clients about a change, from any task
+ */
+void ws_control_notify(void) {
+	if(s_notify) {
+		s_notify();
+	}
+}
+
+/*
+ * power state as commanded or read by the REST handlers
+ */
+void ws_control_set_power(uint8_t power) {
+	if(power != s_power) {
+		s_power = power;
+		ws_control_notify();
+	}
+}
+
+/*
+ * build a state notification (WS_CTRL_STATE_SIZE bytes) into frame
+ */
+size_t ws_control_state(uint8_t *frame, uint32_t credit) {
+	serial_line_t line;
+
+	if(serial_port_get_line(&line) != ESP_OK) {
+		return 0;
+	}
+	frame[0] = WS_CTRL_STATE;
+	frame[1] = s_power;
+	frame[2] = serial_port_get_break();
+	put_le32(frame + 3, line.baud_rate);
+	frame[7] = line.data_bits + 5;
+	frame[8] = line.parity == UART_PARITY_EVEN ? 'E' :
+		(line.parity == UART_PARITY_ODD ? 'O' : 'N');
+	frame[9] = line.stop_bits == UART_STOP_BITS_1 ? 1 :
+		(line.stop_bits == UART_STOP_BITS_2 ? 2 : 3);
+	put_le16(frame + 10, s_cols);
+	put_le16(frame + 12, s_rows);
+	put_le32(frame + 14, credit);
+	return WS_CTRL_STATE_SIZE;
+}
+
+/*
+ * handle a control message from a client (see WS_CTRL_* in rest_server.h);
+ * credit is the flow control state of the client's connection
+ */
+esp_err_t ws_control_handle(const uint8_t *msg, size_t len, uint32_t *credit) {
+	static const uint8_t msg_len[] = {
+		[WS_CTRL_BREAK - WS_CTRL_BREAK] = 3,
+		[WS_CTRL_LINE - WS_CTRL_BREAK] = 8,
+		[WS_CTRL_POWER - WS_CTRL_BREAK] = 2,
+		[WS_CTRL_QUERY - WS_CTRL_BREAK] = 1,
+		[WS_CTRL_CREDIT - WS_CTRL_BREAK] = 5,
+		[WS_CTRL_RESIZE - WS_CTRL_BREAK] = 5,
+	};
+	if(msg[0] < WS_CTRL_BREAK || msg[0] > WS_CTRL_RESIZE ||
+			len != msg_len[msg[0] - WS_CTRL_BREAK]) {
+		ESP_LOGW(TAG, "invalid control message 0x%02x (%d bytes)", msg[0],
+				(int)len);
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	switch(msg[0]) {
+	case WS_CTRL_BREAK: {
+		uint16_t msec = get_le16(msg + 1);
+		esp_timer_stop(s_break_timer);
+		if(serial_port_set_break(msec != 0) == ESP_OK && msec) {
+			esp_timer_start_once(s_break_timer, msec * 1000);
+		}
+		break;
+	}
+	case WS_CTRL_LINE: {
+		serial_line_t line = {
+			.baud_rate = get_le32(msg + 1),
+			.data_bits = msg[5] - 5,
+			.parity = msg[6] == 'E' ? UART_PARITY_EVEN :
+				(msg[6] == 'O' ? UART_PARITY_ODD : UART_PARITY_DISABLE),
+			.stop_bits = msg[7] == 1 ? UART_STOP_BITS_1 :
+				(msg[7] == 2 ? UART_STOP_BITS_2 : UART_STOP_BITS_1_5),
+		};
+		// anything not listed for WS_CTRL_LINE leaves the port as it is
+		if(msg[5] < 5 || msg[5] > 8 ||
+				(msg[6] != 'N' && msg[6] != 'O' && msg[6] != 'E') ||
+				msg[7] < 1 || msg[7] > 3 ||
+				serial_port_set_line(&line) != ESP_OK) {
+			ESP_LOGW(TAG, "invalid line settings");
+			// the client learns the settings in effect
+			ws_control_notify();
+			return ESP_ERR_INVALID_ARG;
+		}
+		break;
+	}
+	case WS_CTRL_POWER:
+		target_pwr_ctrl(msg[1] ? 1 : 0);
+		break;
+	case WS_CTRL_QUERY:
+		ws_control_notify();
+		break;
+	case WS_CTRL_CREDIT: {
+		uint32_t more = get_le32(msg + 1);
+		if(*credit == WS_CREDIT_OFF) {
+			*credit = 0;
+		}
+		*credit = more < WS_CREDIT_OFF - *credit ?
+			*credit + more : WS_CREDIT_OFF - 1;
+		break;
+	}
+	case WS_CTRL_RESIZE:
+		s_cols = get_le16(msg + 1);
+		s_rows = get_le16(msg + 3);
+		ESP_LOGI(TAG, "terminal size %dx%d", s_cols, s_rows);
+		break;
+	}
+	return ESP_OK;
+}
+
+/*
+ * notify tells the server to send state notifications to its clients
+ */
+esp_err_t ws_control_init(ws_control_notify_t notify) {
+	const esp_timer_create_args_t break_timer_args = {
+		.callback = break_end,
+		.name = "ws_break",
+	};
+	esp_err_t ret = esp_timer_create(&break_timer_args, &s_break_timer);
+	if(ret != ESP_OK) {
+		return ret;
+	}
+	s_notify = notify;
+	serial_port_set_callback(ws_control_notify);
+	return ESP_OK;
+}
@@ -0,0 +1,117 @@
+// Checks the benchmark records sent by the device (see main/include/bench.h):
+//  '@' seq(8) len(4) ':' payload(len) crc(8) '\r' '\n'
+// with hex numbers and the CRC-32 of everything between '@' and the crc.
+// Records may be split across frames; anything between records is skipped.
+
+const hdrSize = 14;
+const trlSize = 10;
+const payloadMax = 200;
+
+const crcTable = new Uint32Array(256).map((_, n) => {
+  let c = n;
+  for (let k = 0; k < 8; k++) {
+    c = c & 1 ? 0xedb88320 ^ (c >>> 1) : c >>> 1;
+  }
+  return c;
+});
+
+function crc32(bytes) {
+  let crc = 0xffffffff;
+  for (let i = 0; i < bytes.length; i++) {
+    crc = crcTable[(crc ^ bytes[i]) & 0xff] ^ (crc >>> 8);
+  }
+  return (crc ^ 0xffffffff) >>> 0;
+}
+
+// value of `digits` lower case hex digits, -1 if any is not one
+function parseHex(bytes, pos, digits) {
+  let val = 0;
+  for (let i = pos; i < pos + digits; i++) {
+    const c = bytes[i];
+    if (c >= 0x30 && c <= 0x39) {
+      val = val * 16 + c - 0x30;
+    } else if (c >= 0x61 && c <= 0x66) {
+      val = val * 16 + c - 0x57;
+    } else {
+      return -1;
+    }
+  }
+  return val;
+}
+
+class BenchVerifier {
+  constructor() {
+    this.reset();
+  }
+
+  reset() {
+    this.pending = new Uint8Array(0);
+    this.next = 0; // expected sequence number
+    this.records = 0; // records received intact
+    this.bytes = 0; // bytes received
+    this.corrupted = 0; // records failing the crc
+    this.lost = 0; // records missing in the sequence
+    this.reordered = 0; // records older than the last one
+    this.skipped = 0; // bytes outside of any record
+  }
+
+  push(bytes) {
+    this.bytes += bytes.length;
+    let buf = bytes;
+    if (this.pending.length) {
+      buf = new Uint8Array(this.pending.length + bytes.length);
+      buf.set(this.pending);
+      buf.set(bytes, this.pending.length);
+    }
+
+    let pos = 0;
+    while (pos < buf.length) {
+      const start = buf.indexOf(0x40, pos);
+      if (start < 0) {
+        this.skipped += buf.length - pos;
+        pos = buf.length;
+        break;
+      }
+      this.skipped += start - pos;
+      pos = start;
+      if (buf.length - pos < hdrSize) {
+        break;
+      }
+      const seq = parseHex(buf, pos + 1, 8);
+      const len = parseHex(buf, pos + 9, 4);
+      if (seq < 0 || len < 0 || len > payloadMax || buf[pos + 13] !== 0x3a) {
+        // not a record header
+        this.skipped++;
+        pos++;
+        continue;
+      }
+      const size = hdrSize + len + trlSize;
+      if (buf.length - pos < size) {
+        break;
+      }
+      const crc = parseHex(buf, pos + hdrSize + len, 8);
+      if (
+        crc !== crc32(buf.subarray(pos + 1, pos + hdrSize + len)) ||
+        buf[pos + size - 2] !== 0x0d ||
+        buf[pos + size - 1] !== 0x0a
+      ) {
+        // resync on the next '@'
+        this.corrupted++;
+        this.skipped++;
+        pos++;
+        continue;
+      }
+      if (seq > this.next) {
+        this.lost += seq - this.next;
+      } else if (seq < this.next) {
+        this.reordered++;
+      }
+      this.next = Math.max(this.next, seq + 1);
+      this.records++;
+      pos += size;
+    }
+    this.pending = buf.slice(pos);
+  }
+}
+
+export { BenchVerifier, crc32 };
@@ -0,0 +1,120 @@
+// Binary websocket frames (/ws?codec=raw|lz4): a frame type byte followed by
+// the payload.  Data and control messages share them, numbers are little
+// endian.  See WS_FRAME_* and WS_CTRL_* in main/include/rest_server.h.
+
+import { lz4DecodeBlock } from "./lz4";
+
+const wsFrameData = 0x00;
+const wsFrameDataLz4 = 0x01;
+const wsCtrlBreak = 0x10;
+const wsCtrlLine = 0x11;
+const wsCtrlPower = 0x12;
+const wsCtrlQuery = 0x13;
+const wsCtrlCredit = 0x14;
+const wsCtrlResize = 0x15;
+const wsCtrlState = 0x80;
+
+const textEncoder = new TextEncoder();
+
+// framing picked with the page URL: ?codec=lz4 (compressed binary frames),
+// ?codec=raw (binary frames) or none for text frames
+function pageCodec() {
+  const codec = new URLSearchParams(window.location.search).get("codec");
+  return codec === "raw" || codec === "lz4" ? codec : "";
+}
+
+// UART bytes carried by a data frame, or null for any other frame
+function frameBytes(data) {
+  const frame = new Uint8Array(data);
+  if (frame[0] === wsFrameDataLz4) {
+    return lz4DecodeBlock(frame.subarray(3), frame[1] | (frame[2] << 8));
+  } else if (frame[0] === wsFrameData) {
+    return frame.subarray(1);
+  }
+  return null;
+}
+
+// device state from a state notification, or null for any other frame
+function frameState(data) {
+  const view = new DataView(data);
+  if (view.byteLength < 18 || view.getUint8(0) !== wsCtrlState) {
+    return null;
+  }
+  const power = view.getUint8(1);
+  const credit = view.getUint32(14, true);
+  return {
+    power: power === 0xff ? undefined : power === 1,
+    break: view.getUint8(2) !== 0,
+    baud: view.getUint32(3, true),
+    dataBits: view.getUint8(7),
+    parity: String.fromCharCode(view.getUint8(8)),
+    stopBits: [undefined, "1", "2", "1.5"][view.getUint8(9)],
+    cols: view.getUint16(10, true),
+    rows: view.getUint16(12, true),
+    credit: credit === 0xffffffff ? undefined : credit,
+  };
+}
+
+// data frame from a string or bytes
+function encodeData(data) {
+  const bytes = typeof data === "string" ? textEncoder.encode(data) : data;
+  const frame = new Uint8Array(bytes.length + 1);
+  frame[0] = wsFrameData;
+  frame.set(bytes, 1);
+  return frame;
+}
+
+function control(type, size, fill = () => {}) {
+  const frame = new DataView(new ArrayBuffer(size + 1));
+  frame.setUint8(0, type);
+  fill(frame);
+  return frame.buffer;
+}
+
+// break for msec (0: end it)
+function encodeBreak(msec) {
+  return control(wsCtrlBreak, 2, (f) => f.setUint16(1, msec, true));
+}
+
+// line settings, e.g. (115200, 8, "N", 1); stop bits 3 is 1.5
+function encodeLine(baud, dataBits, parity, stopBits) {
+  return control(wsCtrlLine, 7, (f) => {
+    f.setUint32(1, baud, true);
+    f.setUint8(5, dataBits);
+    f.setUint8(6, parity.charCodeAt(0));
+    f.setUint8(7, stopBits);
+  });
+}
+
+function encodePower(on) {
+  return control(wsCtrlPower, 1, (f) => f.setUint8(1, on ? 1 : 0));
+}
+
+function encodeQuery() {
+  return control(wsCtrlQuery, 0);
+}
+
+// let the device send that many more bytes
+function encodeCredit(bytes) {
+  return control(wsCtrlCredit, 4, (f) => f.setUint32(1, bytes, true));
+}
+
+function encodeResize(cols, rows) {
+  return control(wsCtrlResize, 4, (f) => {
+    f.setUint16(1, cols, true);
+    f.setUint16(3, rows, true);
+  });
+}
+
+export {
+  pageCodec,
+  frameBytes,
+  frameState,
+  encodeData,
+  encodeBreak,
+  encodeLine,
+  encodePower,
+  encodeQuery,
+  encodeCredit,
+  encodeResize,
+};
@@ -0,0 +1,58 @@
+// LZ4 block decoder for the compressed websocket frames
+//
+// Block format: https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+// Each frame is compressed on its own, so no state is kept between calls.
+
+function lz4DecodeBlock(src, rawLen) {
+  const dst = new Uint8Array(rawLen);
+  let ip = 0;
+  let op = 0;
+
+  while (ip < src.length) {
+    const token = src[ip++];
+
+    // literals
+    let lit = token >> 4;
+    if (lit === 15) {
+      let b;
+      do {
+        b = src[ip++];
+        lit += b;
+      } while (b === 255);
+    }
+    dst.set(src.subarray(ip, ip + lit), op);
+    ip += lit;
+    op += lit;
+    if (ip >= src.length) {
+      // the last sequence has no match
+      break;
+    }
+
+    // match
+    const offset = src[ip] | (src[ip + 1] << 8);
+    ip += 2;
+    let mlen = token & 0x0f;
+    if (mlen === 15) {
+      let b;
+      do {
+        b = src[ip++];
+        mlen += b;
+      } while (b === 255);
+    }
+    mlen += 4;
+    if (offset === 0 || offset > op || op + mlen > rawLen) {
+      throw new Error("lz4: corrupted block");
+    }
+    // byte by byte: the match may overlap the output
+    let ref = op - offset;
+    for (let end = op + mlen; op < end; ) {
+      dst[op++] = dst[ref++];
+    }
+  }
+  if (op !== rawLen) {
+    throw new Error("lz4: size mismatch");
+  }
+  return dst;
+}
+
+export { lz4DecodeBlock };
@@ -0,0 +1,121 @@
+// Speculative local echo in the style of mosh: characters typed by the user
+// are shown at once (underlined) and confirmed one by one as their echo
+// arrives from the target. Anything else arriving first drops the
+// predictions, and they stay hidden until one is confirmed again.
+// No predictions are made at password prompts or in full-screen apps.
+
+// a prediction without its echo by then is a miss
+const expireMs = 1500;
+// the last line of output asks for something that is not echoed
+const promptRegex = /\b(password|passphrase|passcode|pin)\b[^:\n]*:\s*$/i;
+const lineMax = 80;
+
+class EchoPredictor {
+  // render(text) shows the predicted characters after the output
+  constructor(render) {
+    this.timer = null;
+    this.reset();
+    // nothing to render before
+    this.render = render;
+  }
+
+  reset() {
+    this.hits = 0; // predictions confirmed by the echo
+    this.misses = 0; // predictions dropped or expired
+    this.rtt = 0; // smoothed keystroke to echo time, msec
+    this.clear();
+  }
+
+  // forget the pending predictions, e.g. when the connection changes
+  clear() {
+    clearTimeout(this.timer);
+    this.pending = [];
+    this.line = ""; // end of the last line of output
+    this.fullScreen = false;
+    this.password = false;
+    this.tentative = false; // predictions are kept hidden
+    this.update();
+  }
+
+  get enabled() {
+    return !this.fullScreen && !this.password;
+  }
+
+  // confirmed share of the predictions, null before the first one
+  get hitRate() {
+    const total = this.hits + this.misses;
+    return total ? this.hits / total : null;
+  }
+
+  // printable character typed and sent
+  keystroke(char) {
+    if (!this.enabled) {
+      return;
+    }
+    this.pending.push({ char, time: performance.now() });
+    if (this.pending.length === 1) {
+      this.schedule();
+    }
+    this.update();
+  }
+
+  // character of output, outside of escape sequences
+  output(char) {
+    if (this.pending.length) {
+      const prediction = this.pending.shift();
+      if (prediction.char === char) {
+        this.hits++;
+        this.tentative = false;
+        const rtt = performance.now() - prediction.time;
+        this.rtt = this.rtt ? this.rtt * 0.875 + rtt * 0.125 : rtt;
+        this.schedule();
+      } else {
+        this.pending.unshift(prediction);
+        this.drop();
+      }
+    }
+    this.line = char === "\n" ? "" : (this.line + char).slice(-lineMax);
+  }
+
+  // alternate screen (\e[?1049h, \e[?47h) in use
+  setFullScreen(flag) {
+    this.fullScreen = flag;
+  }
+
+  // end of a chunk of output
+  flush() {
+    this.password = promptRegex.test(this.line);
+    if (!this.enabled) {
+      this.drop();
+    }
+    this.update();
+  }
+
+  drop() {
+    if (this.pending.length) {
+      this.misses += this.pending.length;
+      this.pending = [];
+      this.tentative = true;
+    }
+  }
+
+  // expiry of the oldest prediction
+  schedule() {
+    clearTimeout(this.timer);
+    if (this.pending.length) {
+      const age = performance.now() - this.pending[0].time;
+      this.timer = setTimeout(() => {
+        this.drop();
+        this.update();
+      }, Math.max(expireMs - age, 0));
+    }
+  }
+
+  update() {
+    this.render?.(
+      this.tentative ? "" : this.pending.map((p) => p.char).join("")
+    );
+  }
+}
+
+export { EchoPredictor };
@@ -39,6 +39,8 @@ class JsShell {
     this._innerWindow = document.createElement("div");
     // this._output = document.createElement("p");
     this._output = document.createElement("span"); // NEW
+    this._prediction = document.createElement("span"); // NEW: local echo
+    this._prediction.style.textDecoration = "underline";
     this._promptPS1 = document.createElement("span");
     this._inputLine = document.createElement("span"); // the span element where the users input is put
     this.cursorType = options.cursorType || "large";
@@ -51,6 +53,7 @@ class JsShell {
     this._input.appendChild(this._inputLine);
     // this._input.appendChild(this._cursor);
     this._innerWindow.appendChild(this._output);
+    this._innerWindow.appendChild(this._prediction); // NEW
     // this._innerWindow.appendChild(this._input);
     this._innerWindow.appendChild(this._cursor); // NEW
     this.html.appendChild(this._innerWindow);
@@ -167,6 +170,39 @@ class JsShell {
     }, this.cursorSpeed);
   }
 
+  // NEW: predicted input, shown after the output until its echo arrives
+  setPrediction(text) {
+    if (this._prediction.textContent !== text) {
+      this._prediction.textContent = text;
+      this.scrollBottom();
+    }
+    return this;
+  }
+
+  // NEW: columns and rows that fit in the window
+  getSize() {
+    const probe = document.createElement("span");
+    probe.textContent = "M".repeat(10);
+    probe.style.visibility = "hidden";
+    probe.style.position = "absolute";
+    this._output.appendChild(probe);
+    const rect = probe.getBoundingClientRect();
+    this._output.removeChild(probe);
+    const style = getComputedStyle(this._innerWindow);
+    const width =
+      this.html.clientWidth -
+      parseFloat(style.paddingLeft) -
+      parseFloat(style.paddingRight);
+    const height =
+      this.html.clientHeight -
+      parseFloat(style.paddingTop) -
+      parseFloat(style.paddingBottom);
+    return {
+      cols: Math.max(Math.floor(width / (rect.width / 10)), 1),
+      rows: Math.max(Math.floor(height / rect.height), 1),
+    };
+  }
+
   scrollBottom() {
     this.html.scrollTop = this.html.scrollHeight;
     return this;
@@ -1,7 +1,13 @@
 import './app.css'
 import App from './App.svelte'
+import Bench from './Bench.svelte'
+import Profile from './Profile.svelte'
 
-const app = new App({
+// the benchmark and profile pages are opened with #bench and #profile
+const pages = { '#bench': Bench, '#profile': Profile }
+const Page = pages[window.location.hash] || App
+
+const app = new Page({
   target: document.getElementById('app'),
 })
 